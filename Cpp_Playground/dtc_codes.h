@@ -0,0 +1,374 @@
+// GENERATED by gen_dtc_codes.py from dtc_codes.csv, don't edit. Change the CSV and rebuild.
+// Included by main.cpp once rbr_isobus_dtc_ts and DtcMake() are defined.
+#pragma once
+
+enum DTC_Codes
+{
+  DFC_EGRVlvDrftClsd,           // 27/17 EGR Valve
+  DFC_FuelPLoP,                 // 94/13 Low fuel pressure error monitoring
+  DFC_FuelPSRCMax,              // 95/3 SRC High for Environment Pressure
+  DFC_FuelPSRCMin,              // 95/4 SRC low for Environment Pressure
+  DFC_FlFWLvlWtHi,              // 97/15 Water in fuel detected
+  DFC_OilPSwmpPhysRngHi,        // 100/0 Maximum oil pressure error in plausibility check
+  DFC_OilPSwmpPhysRngLo,        // 100/1 Minimum oil pressure error in plausibility check
+  DFC_OilPSwmpSRCMax,           // 100/3 SRC high for oil pressure sensor
+  DFC_OilPSwmpSRCMin,           // 100/4 SRC low for Oil pressure sensor
+  DFC_TCACDsPhysRngHi,          // 105/17 Physical Range Check high for Charged Air cooler down stream temperature
+  DFC_PAirFltDSRCMax,           // 107/3 SRC High for Controller Mode Switch
+  DFC_PAirFltDSRCMin,           // 107/4 SRC low for Controller Mode Switch
+  DFC_AirFltClogDet,            // 107/14 Error path for Clog Detection in Air filter
+  DFC_PEnvRngChkMax,            // 108/0 Ambient air pressure sensor range chack max-error
+  DFC_PEnvRngChkMin,            // 108/1 Ambient air pressure sensor range check min-error
+  DFC_PEnvSnsrPlaus,            // 108/2 Ambient air pressure sensor sensor error by component self diagnosis
+  DFC_PEnvSigRngMax,            // 108/3 fault check max signal range violated for ambient air pressure sensor
+  DFC_PEnvSigRngMin,            // 108/4 fault check min signal range violated for ambient air pressure sensor
+  DFC_CEngDsTPhysRngHi,         // 110/0 Physical Range Check high for CEngDsT
+  DFC_CEngDsTSRCMax,            // 110/3 SRC High for Engine coolant temperature(down stream)
+  DFC_CEngDsTSRCMin,            // 110/4 SRC low for Engine coolant temperature(down stream)
+  DFC_CEngDsTNplHigh,           // 110/16 Engine coolant temperature too high plausibility error
+  DFC_CEngDsTAbsTst,            // 110/17 defect fault check for Absolute plausibility test
+  DFC_CEngDsTDynTst,            // 110/18 defect fault check for dynamic plausibility test
+  DFC_RailPSRCMax,              // 157/3 Sensor voltage above upper limit
+  DFC_RailPSRCMin,              // 157/4 Sensor voltage below lower limit
+  DFC_AltIOMonPlaus,            // 167/7 Plausibility check for input signal for monitoring the alternator
+  DFC_BattUSRCMax,              // 168/3 Diagnostic Fault Check for Signal Range Max Check of Battery Voltage
+  DFC_BattUSRCMin,              // 168/4 Diagnostic Fault Check for Signal Range Min Check of Battery Voltage
+  DFC_FuelTPhysRngHi,           // 174/0 Physical Range Check high for fuel temperature
+  DFC_FuelTSRCMax,              // 174/3 SRC high for fuel temperature sensor
+  DFC_FuelTSRCMin,              // 174/4 SRC low for fuel temperature sensor
+  DFC_OilTPhysRngHi,            // 175/0 Physical Range Check high for Oil Temperature
+  DFC_OilTSRCMax,               // 175/3 SRC High for Oil Temperature
+  DFC_OilTSRCMin,               // 175/4 SRC low for Oil Temperature
+  DFC_OilTNplHigh,              // 175/13 Oil temperature too high plausibility error
+  DFC_EpmCaSI1OfsErr,           // 190/2 DFC for camshaft offset angle exceeded
+  DFC_EpmCaSI1ErrSig,           // 190/8 DFC for camshaft signal diagnose - disturbed signal
+  DFC_EpmCrSErrSig,             // 190/9 DFC for crankshaft signal diagnose - disturbed signal
+  DFC_EpmCaSI1NoSig,            // 190/12 DFC for camshaft signal diagnose - no signal
+  DFC_EpmCrSNoSig,              // 190/18 DFC for crankshaft signal diagnose - no signal
+  DFC_StrtCoilHSSCB,            // 430/3 Short circuit to battery error at High side of coil in Inhibit starter strategy
+  DFC_GbxAliveChk,              // 604/2 Alive Detection for Gbx_stNPos
+  DFC_BusDiagBusOffNodeA,       // 639/14 BusOff error CAN A
+  DFC_InjVlv_DI_ScCyl_0,        // 651/3 Short circuit of the power stage low-side (cylinder error)
+  DFC_InjVlv_DI_ScHsLs_0,       // 651/4 Short circuit between high-side and low-side of the power stage (high-side non plausible error)
+  DFC_InjVlv_DI_NoLd_0,         // 651/5 Open load on the power stage
+  DFC_IVAdjDiaIVAdj_0,          // 651/13 check of missing injector adjustment value programming
+  DFC_InjVlv_DI_ScCyl_3,        // 652/3 Short circuit of the power stage low-side (cylinder error)
+  DFC_InjVlv_DI_ScHsLs_3,       // 652/4 Short circuit between high-side and low-side of the power stage (high-side non plausible error)
+  DFC_InjVlv_DI_NoLd_3,         // 652/5 Open load on the power stage
+  DFC_IVAdjDiaIVAdj_3,          // 652/13 check of missing injector adjustment value programming
+  DFC_InjVlv_DI_ScCyl_1,        // 653/3 Short circuit of the power stage low-side (cylinder error)
+  DFC_InjVlv_DI_ScHsLs_1,       // 653/4 Short circuit between high-side and low-side of the power stage (high-side non plausible error)
+  DFC_InjVlv_DI_NoLd_1,         // 653/5 Open load on the power stage
+  DFC_IVAdjDiaIVAdj_1,          // 653/13 check of missing injector adjustment value programming
+  DFC_InjVlv_DI_ScCyl_2,        // 654/3 Short circuit of the power stage low-side (cylinder error)
+  DFC_InjVlv_DI_ScHsLs_2,       // 654/4 Short circuit between high-side and low-side of the power stage (high-side non plausible error)
+  DFC_InjVlv_DI_NoLd_2,         // 654/5 Open load on the power stage
+  DFC_IVAdjDiaIVAdj_2,          // 654/13 check of missing injector adjustment value programming
+  DFC_GlwPlgDiff,               // 676/2 DFC for coding error when different coding words were received in a coding cycle
+  DFC_GlwPlgLVSSCB,             // 676/3 Short circuit to battery error for Low Voltage System
+  DFC_GlwPlgLVSSCG,             // 676/4 Short circuit to ground error for Low Voltage System
+  DFC_GlwPlgLVSOL,              // 676/5 No load error for Low Voltage System
+  DFC_GlwPlgDiagErr,            // 676/11 DFC for faulty diagnostic data transmission or protocol error
+  DFC_GlwPlgLVSOvrTemp,         // 676/12 Over temperature error on ECU powerstage for Glow plug Low Voltage System
+  DFC_GlwPlg2of3,               // 676/21 DFC for coding error when selected coding is not working
+  DFC_StrtLSSCB,                // 677/3 Short circuit to battery error for Starter low side
+  DFC_StrtLSSCG,                // 677/4 Short circuit to ground error for Starter low side
+  DFC_StrtOL,                   // 677/5 No load error for Starter
+  DFC_T50Err,                   // 677/10 Defective T50 switch
+  DFC_StrtLSOvrTemp,            // 677/12 Over temperature error for Starter low side
+  DFC_ComCM1TO,                 // 986/9 Timeout Error of CAN-Receive-Frame Cab Message 1
+  DFC_MeUnOL,                   // 1076/5 open load of metering unit output
+  DFC_MeUnOT,                   // 1076/12 over teperature of device driver of metering unit
+  DFC_MeUnShCirLSBatt,          // 1076/16 short circuit to battery of metering unit output
+  DFC_MeUnShCirLSGnd,           // 1076/18 short circuit to ground of metering unit output
+  DFC_EngICO,                   // 1109/11 Injection cut off demand (ICO) for shut off coordinator
+  DFC_TECUSigRngMax,            // 1136/0 ECU Temperature Sensor MAX
+  DFC_TECUSigRngMin,            // 1136/1 ECU Temperature Sensor MIN
+  DFC_TECUPhysRngHi,            // 1136/16 Diagnostic Fault Check for Physical Signal above maximum limit
+  DFC_BusDiagBusOffNodeB,       // 1231/14 BusOff error CAN B
+  DFC_PCVOL,                    // 1244/5 open load of pressure control valve output
+  DFC_PCVOT,                    // 1244/12 over teperature of device driver of pressure control valve
+  DFC_PCVShCirLSBatt,           // 1244/16 short circuit to battery of pressure control valve output
+  DFC_PCVShCirLSGnd,            // 1244/18 short circuit to ground of the pressure control valve output
+  DFC_EngPrtOvrSpd,             // 1769/11 Overspeed detection in component engine protection
+  DFC_MRlyErlyOpng,             // 2634/11 Early opening defect of main relay
+  DFC_EGRVlvJamVlvOpn,          // 2791/0 EGR Valve OPEN
+  DFC_EGRVlvJamVlvClsd,         // 2791/1 EGR Valve CLOSED
+  DFC_EGRVlvSRCMax,             // 2791/13 EGR Valve SCR MAX
+  DFC_EGRVlvSRCMin,             // 2791/14 EGR Valve SCR MIN
+  DFC_EGRVlvDrftOpn,            // 2791/15 EGR Valve DRFT OPEN
+  DFC_EGRVlvGovDvtMin,          // 2791/16 EGR Valve GOV DVT MIN
+  DFC_EGRVlvGovDvtMax,          // 2791/18 EGR Valve GOV DVT MAX
+  DFC_EEPWrErr,                 // 2802/12 EEP Write Error based on the error in storing the blocks in memory media
+  DFC_EEPRdErr,                 // 2802/14 EEP Read Error based on the error in reading blocks from memory media
+  DFC_SSpMon1,                  // 3509/2 Voltage fault at Sensor supply 1
+  DFC_SSpMon2,                  // 3510/2 Voltage fault at Sensor supply 2
+  DFC_SSpMon3,                  // 3511/2 Voltage fault at Sensor supply 3
+  DFC_GlwPlgPLUGSC_0,           // 5324/4 Array of DFCs for short circuit in i+1th Glow Plug
+  DFC_GlwPlgPLUGErr_0,          // 5324/11 Array of DFCs for failure in i+1th Glow Plug
+  DFC_GlwPlgPLUGSC_1,           // 5325/4 Array of DFCs for short circuit in i+1th Glow Plug
+  DFC_GlwPlgPLUGErr_1,          // 5325/11 Array of DFCs for failure in i+1th Glow Plug
+  DFC_GlwPlgPLUGSC_2,           // 5326/4 Array of DFCs for short circuit in i+1th Glow Plug
+  DFC_GlwPlgPLUGErr_2,          // 5326/11 Array of DFCs for failure in i+1th Glow Plug
+  DFC_GlwPlgPLUGSC_3,           // 5327/4 Array of DFCs for short circuit in i+1th Glow Plug
+  DFC_GlwPlgPLUGErr_3,          // 5327/11 Array of DFCs for failure in i+1th Glow Plug
+  DFC_EGRVlvHBrgShCirBatt1,     // 5763/3 EGR VALVE
+  DFC_EGRVlvHBrgShCirGnd1,      // 5763/4 EGR VALVE
+  DFC_EGRVlvHBrgOpnLd,          // 5763/5 EGR VALVE
+  DFC_EGRVlvHBrgOvrTemp,        // 5763/12 EGR VALVE
+  DFC_EGRVlvHBrgShCirBatt2,     // 5770/3 EGR VALVE
+  DFC_EGRVlvHBrgShCirGnd2,      // 5770/4 EGR VALVE
+  DFC_StrtHSSCB,                // 6385/3 Short circuit to battery error for Starter high side
+  DFC_StrtHSSCG,                // 6385/4 Short circuit to ground error for Starter high side
+  DFC_StrtHSOvrTemp,            // 6385/12 Over temperature error for Starter high side
+  DFC_PSPSCB,                   // 6719/3 short circuit to battery of pre-supply pump output
+  DFC_PSPSCG,                   // 6719/4 short circuit to ground of pre-supply pump output
+  DFC_PSPOL,                    // 6719/5 open load of pre-supply pump output
+  DFC_PSPOvrTemp,               // 6719/12 Over temperature error on ECU powerstage for Pre supply pump
+  DFC_BusDiagBusOffErrPasNodeA, // 22000/14 error passive CAN A
+  DFC_BusDiagBusOffErrPasNodeB, // 22001/15 error passive CAN B
+  DFC_ComTSC1TETO,              // 22040/19 Timeout Error of CAN-Receive-Frame TSC1TE
+  DFC_RailPCV0,                 // 523037/0 maximum positive deviation of rail pressure exceeded
+  DFC_RailPCV2,                 // 523040/0 maximum negative rail pressure deviation with closed pressure control valve exceeded
+  DFC_RailPCV42,                // 523042/0 maximum rail pressure exceeded (second stage)
+  DFC_RailPCV4,                 // 523043/0 maximum rail pressure exceeded
+  DFC_InjVlv_DI_ScBnk_0,        // 523350/4 Short circuit of the power stage high-side (bank error)
+  DFC_InjVlv_DI_ScBnk_1,        // 523352/4 Short circuit of the power stage high-side (bank error)
+  DFC_RailMeUn0,                // 523613/0 maximum positive deviation of rail pressure exceeded
+  DFC_RailMeUn4,                // 523613/16 maximum rail pressure exceeded
+  DFC_GlwPlgUnErr,              // 523676/12 DFC for glow module error in GCU-T
+  DFC_GlwPlgT30Miss,            // 523676/16 DFC for T30 missing error in GCU-T
+  DFC_MoCADCTst,                // 524059/12 Diagnostic fault check to report the ADC test error
+  DFC_MoCADCVltgRatio,          // 524060/12 Diagnostic fault check to report the error in Voltage ratio in ADC monitoring
+  DFC_MoCComErrCnt,             // 524061/12 Diagnostic fault check to report errors in query-/response-communication
+  DFC_MoCComSPI,                // 524062/12 Diagnostic fault check to report errors in SPI-communication
+  DFC_MoCROMErrXPg,             // 524063/12 Diagnostic fault check to report multiple error while checking the complete ROM-memory
+  DFC_MoCSOPErrMMRespByte,      // 524064/12 Loss of synchronization sending bytes to the MM from CPU.
+  DFC_MoCSOPErrNoChk,           // 524065/12 DFC to set a torque limitation once an error is detected before MoCSOP's error reaction is set
+  DFC_MoCSOPErrRespTime,        // 524066/12 Wrong set response time
+  DFC_MoCSOPErrSPI,             // 524067/12 Too many SPI errors during MoCSOP execution.
+  DFC_MoCSOPLoLi,               // 524068/12 Diagnostic fault check to report the error in undervoltage monitoring
+  DFC_MoCSOPMM,                 // 524069/12 Diagnostic fault check to report that WDA is not working correct
+  DFC_MoCSOPOSTimeOut,          // 524070/12 OS timeout in the shut off path test. Failure setting the alarm task period.
+  DFC_MoCSOPPsvTstErr,          // 524071/12 Diagnostic fault check to report that the positive test failed
+  DFC_MoCSOPTimeOut,            // 524072/12 Diagnostic fault check to report the timeout in the shut off path test
+  DFC_MoCSOPUpLi,               // 524073/12 Diagnostic fault check to report the error in overvoltage monitoring
+  DFC_MoFAPP,                   // 524074/12 Diagnostic fault check to report the accelerator pedal position error
+  DFC_MoFESpd,                  // 524075/12 Diagnostic fault check to report the engine speed error
+  DFC_MoFInjDatET,              // 524076/12 Diagnostic fault check to report the plausibility error between level 1 energizing time and level 2 information
+  DFC_MoFInjDatPhi,             // 524077/12 Diagnostic fault check to report the error due to plausibility between the injection begin v/s injection type
+  DFC_MoFInjQnt,                // 524078/12 Diagnostic fault check to report the error due to non plausibility in ZFC
+  DFC_MoFMode2,                 // 524080/12 Diagnosis fault check to report the error to demand for an ICO due to an error in the PoI2 shut-off
+  DFC_MoFMode3,                 // 524081/12 Diagnosis fault check to report the error to demand for an ICO due to an error in the PoI3 efficiency factor
+  DFC_MoFOvR,                   // 524082/12 Diagnostic fault check to report the error due to Over Run
+  DFC_MoFOvRHtPrt,              // 524083/12 Diagnostic fault check to report the error due to cooling injection in Over Run
+  DFC_MoFQntCor,                // 524084/12 Diagnostic fault check to report the error due to injection quantity correction
+  DFC_MoFRailP,                 // 524085/12 Diagnostic fault check to report the plausibility error in rail pressure monitoring
+  DFC_MoFRmtAPP,                // 524086/12 Diagnostic fault check to report the remote accelerator pedal position error
+  DFC_MoFTrqCmp,                // 524087/12 Diagnostic fault check to report the error due to torque comparison
+  DFC_MonLimCurr,               // 524088/12 Diagnosis of curr path limitation forced by ECU monitoring level 2
+  DFC_MonLimLead,               // 524089/12 Diagnosis of lead path limitation forced by ECU monitoring level 2
+  DFC_MonLimSet,                // 524090/12 Diagnosis of set path limitation forced by ECU monitoring level 2
+  DFC_MoFInjDatBlkShtET,        // 524093/12 Diagnostic fault check to report the plausibility error for Blankshot injection
+  DFC_OCWDACom_ERR,             // 524098/12 Not the same name cuz it exists elsewhere.. Diagnostic fault check to report "WDA active" due to errors in query-/response communication
+  DFC_OCWDALowVltg,             // 524099/12 Diagnostic fault check to report "ABE active" due to undervoltage detection
+  DFC_OCWDAOvrVltg,             // 524100/12 Diagnostic fault check to report "ABE active" due to overvoltage detection
+  DFC_OCWDAReasUnkwn,           // 524101/12 Diagnostic fault check to report "WDA/ABE active" due to unknown reason
+  DFC_RailMeUn10,               // 524104/0 leakage is detected based on fuel quantity balance
+  DFC_RailMeUn2,                // 524105/0 maximum negative rail pressure deviation with metering unit on lower limit is exceeded
+  DFC_SWReset_0,                // 524120/14 Visibility of SoftwareResets in DSM
+  DFC_SWReset_1,                // 524121/14 Visibility of SoftwareResets in DSM
+  DFC_SWReset_2,                // 524122/14 Visibility of SoftwareResets in DSM
+  DFC_MoCADCNTP,                // 524124/12 Diagnostic fault check to report the NTP error in ADC monitoring
+  DFC_MoFStrt,                  // 524128/12 function monitoring: fault in the monitoring of the start control
+  DFC_Cy327SpiCom,              // 524131/12 CY327 SPI Communication Error
+  DFC_E2EAliveCtr,              // 524132/9 E2E alive counter of a received message stuck or jumped
+  DFC_E2ECrc,                   // 524133/19 E2E CRC of a received message wrong
+  NUM_DTC_CODES // Special value to represent the total number of DTC codes
+};
+
+// DM1/DM2 CODES, one per DTC_Codes entry in the same order
+constexpr rbr_isobus_dtc_ts dtc_info_array[] = {
+    DtcMake(27, 17, 0),            // DFC_EGRVlvDrftClsd
+    DtcMake(94, 13, 0),            // DFC_FuelPLoP
+    DtcMake(95, 3, 0),             // DFC_FuelPSRCMax
+    DtcMake(95, 4, 0),             // DFC_FuelPSRCMin
+    DtcMake(97, 15, 0),            // DFC_FlFWLvlWtHi
+    DtcMake(100, 0, 0),            // DFC_OilPSwmpPhysRngHi
+    DtcMake(100, 1, 0),            // DFC_OilPSwmpPhysRngLo
+    DtcMake(100, 3, 0),            // DFC_OilPSwmpSRCMax
+    DtcMake(100, 4, 0),            // DFC_OilPSwmpSRCMin
+    DtcMake(105, 17, 0),           // DFC_TCACDsPhysRngHi
+    DtcMake(107, 3, 0),            // DFC_PAirFltDSRCMax
+    DtcMake(107, 4, 0),            // DFC_PAirFltDSRCMin
+    DtcMake(107, 14, 0),           // DFC_AirFltClogDet
+    DtcMake(108, 0, 0),            // DFC_PEnvRngChkMax
+    DtcMake(108, 1, 0),            // DFC_PEnvRngChkMin
+    DtcMake(108, 2, 0),            // DFC_PEnvSnsrPlaus
+    DtcMake(108, 3, 0),            // DFC_PEnvSigRngMax
+    DtcMake(108, 4, 0),            // DFC_PEnvSigRngMin
+    DtcMake(110, 0, 0),            // DFC_CEngDsTPhysRngHi
+    DtcMake(110, 3, 0),            // DFC_CEngDsTSRCMax
+    DtcMake(110, 4, 0),            // DFC_CEngDsTSRCMin
+    DtcMake(110, 16, 0),           // DFC_CEngDsTNplHigh
+    DtcMake(110, 17, 0),           // DFC_CEngDsTAbsTst
+    DtcMake(110, 18, 0),           // DFC_CEngDsTDynTst
+    DtcMake(157, 3, 0),            // DFC_RailPSRCMax
+    DtcMake(157, 4, 0),            // DFC_RailPSRCMin
+    DtcMake(167, 7, 0),            // DFC_AltIOMonPlaus
+    DtcMake(168, 3, 0),            // DFC_BattUSRCMax
+    DtcMake(168, 4, 0),            // DFC_BattUSRCMin
+    DtcMake(174, 0, 0),            // DFC_FuelTPhysRngHi
+    DtcMake(174, 3, 0),            // DFC_FuelTSRCMax
+    DtcMake(174, 4, 0),            // DFC_FuelTSRCMin
+    DtcMake(175, 0, 0),            // DFC_OilTPhysRngHi
+    DtcMake(175, 3, 0),            // DFC_OilTSRCMax
+    DtcMake(175, 4, 0),            // DFC_OilTSRCMin
+    DtcMake(175, 13, 0),           // DFC_OilTNplHigh
+    DtcMake(190, 2, 0),            // DFC_EpmCaSI1OfsErr
+    DtcMake(190, 8, 0),            // DFC_EpmCaSI1ErrSig
+    DtcMake(190, 9, 0),            // DFC_EpmCrSErrSig
+    DtcMake(190, 12, 0),           // DFC_EpmCaSI1NoSig
+    DtcMake(190, 18, 0),           // DFC_EpmCrSNoSig
+    DtcMake(430, 3, 0),            // DFC_StrtCoilHSSCB
+    DtcMake(604, 2, 0),            // DFC_GbxAliveChk
+    DtcMake(639, 14, 0),           // DFC_BusDiagBusOffNodeA
+    DtcMake(651, 3, 0),            // DFC_InjVlv_DI_ScCyl_0
+    DtcMake(651, 4, 0),            // DFC_InjVlv_DI_ScHsLs_0
+    DtcMake(651, 5, 0),            // DFC_InjVlv_DI_NoLd_0
+    DtcMake(651, 13, 0),           // DFC_IVAdjDiaIVAdj_0
+    DtcMake(652, 3, 0),            // DFC_InjVlv_DI_ScCyl_3
+    DtcMake(652, 4, 0),            // DFC_InjVlv_DI_ScHsLs_3
+    DtcMake(652, 5, 0),            // DFC_InjVlv_DI_NoLd_3
+    DtcMake(652, 13, 0),           // DFC_IVAdjDiaIVAdj_3
+    DtcMake(653, 3, 0),            // DFC_InjVlv_DI_ScCyl_1
+    DtcMake(653, 4, 0),            // DFC_InjVlv_DI_ScHsLs_1
+    DtcMake(653, 5, 0),            // DFC_InjVlv_DI_NoLd_1
+    DtcMake(653, 13, 0),           // DFC_IVAdjDiaIVAdj_1
+    DtcMake(654, 3, 0),            // DFC_InjVlv_DI_ScCyl_2
+    DtcMake(654, 4, 0),            // DFC_InjVlv_DI_ScHsLs_2
+    DtcMake(654, 5, 0),            // DFC_InjVlv_DI_NoLd_2
+    DtcMake(654, 13, 0),           // DFC_IVAdjDiaIVAdj_2
+    DtcMake(676, 2, 0),            // DFC_GlwPlgDiff
+    DtcMake(676, 3, 0),            // DFC_GlwPlgLVSSCB
+    DtcMake(676, 4, 0),            // DFC_GlwPlgLVSSCG
+    DtcMake(676, 5, 0),            // DFC_GlwPlgLVSOL
+    DtcMake(676, 11, 0),           // DFC_GlwPlgDiagErr
+    DtcMake(676, 12, 0),           // DFC_GlwPlgLVSOvrTemp
+    DtcMake(676, 21, 0),           // DFC_GlwPlg2of3
+    DtcMake(677, 3, 0),            // DFC_StrtLSSCB
+    DtcMake(677, 4, 0),            // DFC_StrtLSSCG
+    DtcMake(677, 5, 0),            // DFC_StrtOL
+    DtcMake(677, 10, 0),           // DFC_T50Err
+    DtcMake(677, 12, 0),           // DFC_StrtLSOvrTemp
+    DtcMake(986, 9, 0),            // DFC_ComCM1TO
+    DtcMake(1076, 5, 0),           // DFC_MeUnOL
+    DtcMake(1076, 12, 0),          // DFC_MeUnOT
+    DtcMake(1076, 16, 0),          // DFC_MeUnShCirLSBatt
+    DtcMake(1076, 18, 0),          // DFC_MeUnShCirLSGnd
+    DtcMake(1109, 11, 0),          // DFC_EngICO
+    DtcMake(1136, 0, 0),           // DFC_TECUSigRngMax
+    DtcMake(1136, 1, 0),           // DFC_TECUSigRngMin
+    DtcMake(1136, 16, 0),          // DFC_TECUPhysRngHi
+    DtcMake(1231, 14, 0),          // DFC_BusDiagBusOffNodeB
+    DtcMake(1244, 5, 0),           // DFC_PCVOL
+    DtcMake(1244, 12, 0),          // DFC_PCVOT
+    DtcMake(1244, 16, 0),          // DFC_PCVShCirLSBatt
+    DtcMake(1244, 18, 0),          // DFC_PCVShCirLSGnd
+    DtcMake(1769, 11, 0),          // DFC_EngPrtOvrSpd
+    DtcMake(2634, 11, 0),          // DFC_MRlyErlyOpng
+    DtcMake(2791, 0, 0),           // DFC_EGRVlvJamVlvOpn
+    DtcMake(2791, 1, 0),           // DFC_EGRVlvJamVlvClsd
+    DtcMake(2791, 13, 0),          // DFC_EGRVlvSRCMax
+    DtcMake(2791, 14, 0),          // DFC_EGRVlvSRCMin
+    DtcMake(2791, 15, 0),          // DFC_EGRVlvDrftOpn
+    DtcMake(2791, 16, 0),          // DFC_EGRVlvGovDvtMin
+    DtcMake(2791, 18, 0),          // DFC_EGRVlvGovDvtMax
+    DtcMake(2802, 12, 0),          // DFC_EEPWrErr
+    DtcMake(2802, 14, 0),          // DFC_EEPRdErr
+    DtcMake(3509, 2, 0),           // DFC_SSpMon1
+    DtcMake(3510, 2, 0),           // DFC_SSpMon2
+    DtcMake(3511, 2, 0),           // DFC_SSpMon3
+    DtcMake(5324, 4, 0),           // DFC_GlwPlgPLUGSC_0
+    DtcMake(5324, 11, 0),          // DFC_GlwPlgPLUGErr_0
+    DtcMake(5325, 4, 0),           // DFC_GlwPlgPLUGSC_1
+    DtcMake(5325, 11, 0),          // DFC_GlwPlgPLUGErr_1
+    DtcMake(5326, 4, 0),           // DFC_GlwPlgPLUGSC_2
+    DtcMake(5326, 11, 0),          // DFC_GlwPlgPLUGErr_2
+    DtcMake(5327, 4, 0),           // DFC_GlwPlgPLUGSC_3
+    DtcMake(5327, 11, 0),          // DFC_GlwPlgPLUGErr_3
+    DtcMake(5763, 3, 0),           // DFC_EGRVlvHBrgShCirBatt1
+    DtcMake(5763, 4, 0),           // DFC_EGRVlvHBrgShCirGnd1
+    DtcMake(5763, 5, 0),           // DFC_EGRVlvHBrgOpnLd
+    DtcMake(5763, 12, 0),          // DFC_EGRVlvHBrgOvrTemp
+    DtcMake(5770, 3, 0),           // DFC_EGRVlvHBrgShCirBatt2
+    DtcMake(5770, 4, 0),           // DFC_EGRVlvHBrgShCirGnd2
+    DtcMake(6385, 3, 0),           // DFC_StrtHSSCB
+    DtcMake(6385, 4, 0),           // DFC_StrtHSSCG
+    DtcMake(6385, 12, 0),          // DFC_StrtHSOvrTemp
+    DtcMake(6719, 3, 0),           // DFC_PSPSCB
+    DtcMake(6719, 4, 0),           // DFC_PSPSCG
+    DtcMake(6719, 5, 0),           // DFC_PSPOL
+    DtcMake(6719, 12, 0),          // DFC_PSPOvrTemp
+    DtcMake(22000, 14, 0),         // DFC_BusDiagBusOffErrPasNodeA
+    DtcMake(22001, 15, 0),         // DFC_BusDiagBusOffErrPasNodeB
+    DtcMake(22040, 19, 0),         // DFC_ComTSC1TETO
+    DtcMake(523037, 0, 0),         // DFC_RailPCV0
+    DtcMake(523040, 0, 0),         // DFC_RailPCV2
+    DtcMake(523042, 0, 0),         // DFC_RailPCV42
+    DtcMake(523043, 0, 0),         // DFC_RailPCV4
+    DtcMake(523350, 4, 0),         // DFC_InjVlv_DI_ScBnk_0
+    DtcMake(523352, 4, 0),         // DFC_InjVlv_DI_ScBnk_1
+    DtcMake(523613, 0, 0),         // DFC_RailMeUn0
+    DtcMake(523613, 16, 0),        // DFC_RailMeUn4
+    DtcMake(523676, 12, 0),        // DFC_GlwPlgUnErr
+    DtcMake(523676, 16, 0),        // DFC_GlwPlgT30Miss
+    DtcMake(524059, 12, 0),        // DFC_MoCADCTst
+    DtcMake(524060, 12, 0),        // DFC_MoCADCVltgRatio
+    DtcMake(524061, 12, 0),        // DFC_MoCComErrCnt
+    DtcMake(524062, 12, 0),        // DFC_MoCComSPI
+    DtcMake(524063, 12, 0),        // DFC_MoCROMErrXPg
+    DtcMake(524064, 12, 0),        // DFC_MoCSOPErrMMRespByte
+    DtcMake(524065, 12, 0),        // DFC_MoCSOPErrNoChk
+    DtcMake(524066, 12, 0),        // DFC_MoCSOPErrRespTime
+    DtcMake(524067, 12, 0),        // DFC_MoCSOPErrSPI
+    DtcMake(524068, 12, 0),        // DFC_MoCSOPLoLi
+    DtcMake(524069, 12, 0),        // DFC_MoCSOPMM
+    DtcMake(524070, 12, 0),        // DFC_MoCSOPOSTimeOut
+    DtcMake(524071, 12, 0),        // DFC_MoCSOPPsvTstErr
+    DtcMake(524072, 12, 0),        // DFC_MoCSOPTimeOut
+    DtcMake(524073, 12, 0),        // DFC_MoCSOPUpLi
+    DtcMake(524074, 12, 0),        // DFC_MoFAPP
+    DtcMake(524075, 12, 0),        // DFC_MoFESpd
+    DtcMake(524076, 12, 0),        // DFC_MoFInjDatET
+    DtcMake(524077, 12, 0),        // DFC_MoFInjDatPhi
+    DtcMake(524078, 12, 0),        // DFC_MoFInjQnt
+    DtcMake(524080, 12, 0),        // DFC_MoFMode2
+    DtcMake(524081, 12, 0),        // DFC_MoFMode3
+    DtcMake(524082, 12, 0),        // DFC_MoFOvR
+    DtcMake(524083, 12, 0),        // DFC_MoFOvRHtPrt
+    DtcMake(524084, 12, 0),        // DFC_MoFQntCor
+    DtcMake(524085, 12, 0),        // DFC_MoFRailP
+    DtcMake(524086, 12, 0),        // DFC_MoFRmtAPP
+    DtcMake(524087, 12, 0),        // DFC_MoFTrqCmp
+    DtcMake(524088, 12, 0),        // DFC_MonLimCurr
+    DtcMake(524089, 12, 0),        // DFC_MonLimLead
+    DtcMake(524090, 12, 0),        // DFC_MonLimSet
+    DtcMake(524093, 12, 0),        // DFC_MoFInjDatBlkShtET
+    DtcMake(524098, 12, 0),        // DFC_OCWDACom_ERR
+    DtcMake(524099, 12, 0),        // DFC_OCWDALowVltg
+    DtcMake(524100, 12, 0),        // DFC_OCWDAOvrVltg
+    DtcMake(524101, 12, 0),        // DFC_OCWDAReasUnkwn
+    DtcMake(524104, 0, 0),         // DFC_RailMeUn10
+    DtcMake(524105, 0, 0),         // DFC_RailMeUn2
+    DtcMake(524120, 14, 0),        // DFC_SWReset_0
+    DtcMake(524121, 14, 0),        // DFC_SWReset_1
+    DtcMake(524122, 14, 0),        // DFC_SWReset_2
+    DtcMake(524124, 12, 0),        // DFC_MoCADCNTP
+    DtcMake(524128, 12, 0),        // DFC_MoFStrt
+    DtcMake(524131, 12, 0),        // DFC_Cy327SpiCom
+    DtcMake(524132, 9, 0),         // DFC_E2EAliveCtr
+    DtcMake(524133, 19, 0)         // DFC_E2ECrc
+};
+
+static_assert(sizeof(dtc_info_array) / sizeof(dtc_info_array[0]) == NUM_DTC_CODES, "dtc_info_array and DTC_Codes are out of sync");
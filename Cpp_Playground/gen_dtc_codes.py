@@ -0,0 +1,102 @@
+"""Generates dtc_codes.h (the DTC_Codes enum and the packed dtc_info_array) from dtc_codes.csv.
+
+Runs as a pre-build step when the CSV (or this script) is newer than the header; without Python on PATH
+the build uses the committed header. The header is only rewritten when its content changes; otherwise it is
+just touched, so the build sees it as up to date and doesn't run this again every time. Fails the build on bad rows: duplicate names or SPN/FMI pairs, SPNs that
+don't fit in 19 bits, FMIs that don't fit in 5 bits.
+
+usage: python gen_dtc_codes.py [dtc_codes.csv] [dtc_codes.h]
+"""
+import csv
+import os
+import re
+import sys
+
+SPN_MAX = (1 << 19) - 1
+FMI_MAX = (1 << 5) - 1
+NAME_RE = re.compile(r"^[A-Za-z_][A-Za-z0-9_]*$")
+
+
+def read_rows(csv_path):
+    rows = []
+    errors = []
+    names = {}
+    codes = {}
+    with open(csv_path, newline="", encoding="utf-8") as f:
+        for line, row in enumerate(csv.DictReader(f), start=2):
+            name = row["name"].strip()
+            try:
+                spn = int(row["spn"])
+                fmi = int(row["fmi"])
+            except ValueError:
+                errors.append(f"{csv_path}:{line}: spn/fmi of {name} aren't numbers")
+                continue
+            desc = " ".join(row["description"].split())
+            if not NAME_RE.match(name):
+                errors.append(f"{csv_path}:{line}: '{name}' isn't a valid identifier")
+            if not 0 <= spn <= SPN_MAX:
+                errors.append(f"{csv_path}:{line}: SPN {spn} of {name} doesn't fit in 19 bits")
+            if not 0 <= fmi <= FMI_MAX:
+                errors.append(f"{csv_path}:{line}: FMI {fmi} of {name} doesn't fit in 5 bits")
+            if name in names:
+                errors.append(f"{csv_path}:{line}: {name} already defined on line {names[name]}")
+            if (spn, fmi) in codes:
+                errors.append(f"{csv_path}:{line}: {name} has the same SPN {spn} / FMI {fmi} as {codes[(spn, fmi)]}")
+            names[name] = line
+            codes[(spn, fmi)] = name
+            rows.append((name, spn, fmi, desc))
+    return rows, errors
+
+
+def render(rows, csv_name):
+    name_width = max(len(name) for name, _, _, _ in rows) + 1
+    out = []
+    out.append(f"// GENERATED by gen_dtc_codes.py from {csv_name}, don't edit. Change the CSV and rebuild.")
+    out.append("// Included by main.cpp once rbr_isobus_dtc_ts and DtcMake() are defined.")
+    out.append("#pragma once")
+    out.append("")
+    out.append("enum DTC_Codes")
+    out.append("{")
+    for name, spn, fmi, desc in rows:
+        out.append(f"  {(name + ','):<{name_width}} // {spn}/{fmi} {desc}")
+    out.append("  NUM_DTC_CODES // Special value to represent the total number of DTC codes")
+    out.append("};")
+    out.append("")
+    out.append("// DM1/DM2 CODES, one per DTC_Codes entry in the same order")
+    out.append("constexpr rbr_isobus_dtc_ts dtc_info_array[] = {")
+    for i, (name, spn, fmi, _) in enumerate(rows):
+        sep = "," if i + 1 < len(rows) else " "
+        out.append(f"    DtcMake({spn}, {fmi}, 0){sep}{' ' * (16 - len(str(spn)) - len(str(fmi)))}// {name}")
+    out.append("};")
+    out.append("")
+    out.append("static_assert(sizeof(dtc_info_array) / sizeof(dtc_info_array[0]) == NUM_DTC_CODES, \"dtc_info_array and DTC_Codes are out of sync\");")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    csv_path = sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, "dtc_codes.csv")
+    header_path = sys.argv[2] if len(sys.argv) > 2 else os.path.join(here, "dtc_codes.h")
+    rows, errors = read_rows(csv_path)
+    if not rows:
+        errors.append(f"{csv_path}: no DTCs")
+    if errors:
+        for error in errors:
+            print(f"error: {error}", file=sys.stderr)
+        return 1
+    text = render(rows, os.path.basename(csv_path))
+    try:
+        with open(header_path, encoding="utf-8", newline="") as f:
+            if f.read() == text:
+                os.utime(header_path)  # newer than the inputs again, or MSBuild reruns us on every build
+                return 0
+    except FileNotFoundError:
+        pass
+    with open(header_path, "w", encoding="utf-8", newline="") as f:
+        f.write(text)
+    print(f"gen_dtc_codes: wrote {len(rows)} DTCs to {header_path}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
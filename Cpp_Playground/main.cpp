@@ -4,6 +4,14 @@
 #include <stdlib.h>
 #include <random>
 #include <math.h>
+#include <string.h>
+#include <stddef.h>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 typedef struct
 {
@@ -20,6 +28,9 @@ uint64_t seconds();
 uint64_t millis();
 uint64_t micros();
 uint64_t nanos();
+uint64_t wallNanos();
+typedef uint64_t (*time_source_fn)(void* ctx); // ns since program start
+void setTimeSource(time_source_fn source, void* ctx);
 bool timerMillis(uint64_t* prevTime, uint64_t timeout, bool resetPrevTime, uint64_t current_time, bool useFakeMillis);
 double scale(double input, double minIn, double maxIn, double minOut, double maxOut, bool clipOutput);
 
@@ -32,6 +43,8 @@ int getBoolFromCanTelegram(uint8_t telegram[], uint8_t sizeOfTelegram, bool* out
 int getIntFromCanTelegram(uint8_t telegram[], uint8_t sizeOfTelegram, int* output, SPN_Config spnConfig);
 
 auto startTime = std::chrono::steady_clock::now(); //steady clock is great for timers, not great for epoch
+time_source_fn timeSource = NULL; // where millis()/micros()/nanos()... get the time from, NULL = steady_clock
+void* timeSourceCtx = NULL;
 
 # define PI 3.14159265358979323846
 # define PI_2 1.57079632679489661923
@@ -44,7 +57,7 @@ float invSqrt(float x)
   union
   {
     float f;
-    long i;
+    int32_t i; // has to be 32 bits, long is 64 on Linux
   } conv = { x };
   conv.i = 0x5f3759df - (conv.i >> 1);
   conv.f *= 1.5f - (halfx * conv.f * conv.f);
@@ -99,6 +112,191 @@ float fsc_atan2f(float y, float x)
     return (angle);
 }
 
+//---------------------------------------------------------------------------------------------------------
+// HOT-PATH TRACING
+// TRACE_SCOPE(probe) times the rest of the enclosing scope into a per-thread latency histogram, and
+// TraceDump() prints count/p50/p90/p99/p99.9/max per probe, merged over all threads.
+// Build with ENABLE_TRACE=1 to turn it on. Otherwise TRACE_SCOPE() compiles to nothing.
+// Probes read the TSC (a few ns) instead of steady_clock through nanos(); ticks are only converted to ns
+// when dumping. Histograms are HDR style: 16 linear sub-buckets per power of two, so ~6% resolution.
+//---------------------------------------------------------------------------------------------------------
+#ifndef ENABLE_TRACE
+#define ENABLE_TRACE 0
+#endif
+
+typedef enum
+{
+  TRACE_EXTRACT_VALUE,
+  TRACE_INSERT_VALUE,
+  TRACE_SERIALIZE_DTC,
+  TRACE_PARSE_DTC,
+  TRACE_MAIN_LOOP,
+  NUM_TRACE_PROBES // Special value to represent the total number of probes
+} trace_probe;
+
+#if ENABLE_TRACE
+#if defined(_MSC_VER)
+#define TRACE_HAVE_TSC 1 // __rdtsc() comes from <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_HAVE_TSC 1
+#endif
+
+#define TRACE_MAX_THREADS 64
+#define TRACE_SUB_BITS 4
+#define TRACE_SUB_BUCKETS (1 << TRACE_SUB_BITS)
+#define TRACE_HIST_BUCKETS ((64 - TRACE_SUB_BITS + 1) * TRACE_SUB_BUCKETS)
+
+const char* traceProbeNames[NUM_TRACE_PROBES] = {
+    "ExtractValueFromCanTelegram",
+    "InsertValueToCanTelegram",
+    "SerializeDTCMessages",
+    "ParseDTCMessages",
+    "main loop"};
+
+typedef struct trace_thread_t
+{
+  std::atomic<uint32_t> counts[NUM_TRACE_PROBES][TRACE_HIST_BUCKETS]; // only the owning thread writes, TraceDump() reads
+  std::atomic<uint64_t> maxTicks[NUM_TRACE_PROBES];
+} trace_thread_ts;
+
+std::atomic<trace_thread_ts*> traceThreads[TRACE_MAX_THREADS]; // published with release, so TraceDump() sees the zeroed counters
+std::atomic<uint32_t> traceNumThreads(0);
+thread_local trace_thread_ts* traceLocal = NULL;
+double traceNsPerTick = 0.0;
+
+uint64_t TraceTicks(void)
+{
+#ifdef TRACE_HAVE_TSC
+  return __rdtsc();
+#else
+  return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// bucket 0..15 = exact, after that 16 sub-buckets per power of two
+uint16_t TraceBucket(uint64_t ticks)
+{
+  if (ticks < TRACE_SUB_BUCKETS)
+    return (uint16_t)ticks;
+#ifdef _MSC_VER
+  unsigned long msb;
+  _BitScanReverse64(&msb, ticks);
+#else
+  uint32_t msb = 63 - __builtin_clzll(ticks);
+#endif
+  return (uint16_t)((msb - TRACE_SUB_BITS + 1) * TRACE_SUB_BUCKETS + ((ticks >> (msb - TRACE_SUB_BITS)) & (TRACE_SUB_BUCKETS - 1)));
+}
+
+uint64_t TraceBucketValue(uint16_t bucket) // lower edge of the bucket, in ticks
+{
+  if (bucket < TRACE_SUB_BUCKETS)
+    return bucket;
+  uint32_t msb = bucket / TRACE_SUB_BUCKETS + TRACE_SUB_BITS - 1;
+  return (uint64_t)(TRACE_SUB_BUCKETS + bucket % TRACE_SUB_BUCKETS) << (msb - TRACE_SUB_BITS);
+}
+
+trace_thread_ts* TraceRegisterThread(void)
+{
+  uint32_t index = traceNumThreads.fetch_add(1, std::memory_order_relaxed);
+  if (index >= TRACE_MAX_THREADS)
+  {
+    traceNumThreads.store(TRACE_MAX_THREADS, std::memory_order_relaxed);
+    return NULL;
+  }
+  trace_thread_ts* local = new trace_thread_ts(); // value-initialized: all zero
+  traceThreads[index].store(local, std::memory_order_release);
+  return local;
+}
+
+void TraceRecord(trace_probe probe, uint64_t ticks)
+{
+  if (traceLocal == NULL && (traceLocal = TraceRegisterThread()) == NULL)
+    return; // more threads than TRACE_MAX_THREADS, drop it
+  std::atomic<uint32_t>* count = &traceLocal->counts[probe][TraceBucket(ticks)];
+  count->store(count->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); // single writer, no locked add needed
+  if (ticks > traceLocal->maxTicks[probe].load(std::memory_order_relaxed))
+    traceLocal->maxTicks[probe].store(ticks, std::memory_order_relaxed);
+}
+
+// measures how long a tick is against the wall clock (virtual time doesn't move while we wait), takes ~10 ms
+void TraceCalibrate(void)
+{
+  uint64_t startNs = wallNanos();
+  uint64_t startTicks = TraceTicks();
+  while (wallNanos() - startNs < 10000000)
+  {
+  }
+  traceNsPerTick = (double)(wallNanos() - startNs) / (double)(TraceTicks() - startTicks);
+}
+
+void TraceDump(FILE* out)
+{
+  if (traceNsPerTick == 0.0)
+    TraceCalibrate();
+  static uint32_t merged[TRACE_HIST_BUCKETS];
+  const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+  uint32_t numThreads = traceNumThreads.load(std::memory_order_acquire);
+  if (numThreads > TRACE_MAX_THREADS)
+    numThreads = TRACE_MAX_THREADS;
+
+  fprintf(out, "%-30s %10s %10s %10s %10s %10s %10s\n", "probe", "count", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+  int p;
+  for (p = 0; p < NUM_TRACE_PROBES; p++)
+  {
+    uint64_t total = 0;
+    uint64_t maxTicks = 0;
+    memset(merged, 0, sizeof(merged));
+    uint32_t t;
+    for (t = 0; t < numThreads; t++)
+    {
+      trace_thread_ts* thread = traceThreads[t].load(std::memory_order_acquire);
+      if (thread == NULL) // registered, pointer not published yet
+        continue;
+      int b;
+      for (b = 0; b < TRACE_HIST_BUCKETS; b++)
+      {
+        uint32_t c = thread->counts[p][b].load(std::memory_order_relaxed);
+        merged[b] += c;
+        total += c;
+      }
+      uint64_t threadMax = thread->maxTicks[p].load(std::memory_order_relaxed);
+      maxTicks = (threadMax > maxTicks) ? threadMax : maxTicks;
+    }
+    if (total == 0)
+      continue;
+    double values[4];
+    int q;
+    for (q = 0; q < 4; q++)
+    {
+      uint64_t rank = (uint64_t)(quantiles[q] * total);
+      uint64_t seen = 0;
+      int b = 0;
+      while (b < TRACE_HIST_BUCKETS - 1 && (seen += merged[b]) <= rank)
+        b++;
+      values[q] = TraceBucketValue(b) * traceNsPerTick;
+    }
+    fprintf(out, "%-30s %10llu %10.0f %10.0f %10.0f %10.0f %10.0f\n", traceProbeNames[p], (unsigned long long)total,
+      values[0], values[1], values[2], values[3], maxTicks * traceNsPerTick);
+  }
+}
+
+typedef struct trace_scope_t
+{
+  trace_probe probe;
+  uint64_t start;
+  trace_scope_t(trace_probe p) : probe(p), start(TraceTicks()) {}
+  ~trace_scope_t() { TraceRecord(probe, TraceTicks() - start); }
+} trace_scope_ts;
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(probe) trace_scope_ts TRACE_CONCAT(traceScope_, __LINE__)(probe)
+#else
+#define TRACE_SCOPE(probe)
+#define TraceDump(out)
+#endif
+
 #define SHIFT_8b 8
 
 
@@ -122,391 +320,128 @@ float fsc_atan2f(float y, float x)
 
 #define RBR_ISOBUS_DTC_LIST_SIZE_DU16           20u
 
+// DTCs are packed into 4 bytes: spn(18-0) fmi(23-19) oc(30-24) cm(31). Same fields as on the wire in DM1,
+// but with the SPN in one piece, so (spn, fmi) compares as one masked word. The enum and dtc_info_array
+// are generated from dtc_codes.csv by gen_dtc_codes.py (a pre-build step), edit the CSV instead.
+#define SHIFT_DTC_FMI 19
+#define SHIFT_DTC_OCC 24
+#define SHIFT_DTC_CM 31
+#define MASK_DTC_SPN 0x7FFFF
+#define MASK_DTC_FMI 0x1F
+#define MASK_DTC_OCC 0x7F
+#define MASK_DTC_KEY 0xFFFFFF // spn + fmi, what identifies a DTC
+
 typedef struct rbr_isobus_dtc_t
 {
-  uint32_t spn_u32;
-  uint8_t  fmi_u8;
-  uint8_t  occ_u8;
+  uint32_t word;
 } rbr_isobus_dtc_ts;
 
-enum DTC_Codes
-{
-  DFC_EGRVlvDrftClsd,
-  DFC_FuelPLoP,
-  DFC_FuelPSRCMax,
-  DFC_FuelPSRCMin,
-  DFC_FlFWLvlWtHi,
-  DFC_OilPSwmpPhysRngHi,
-  DFC_OilPSwmpPhysRngLo,
-  DFC_OilPSwmpSRCMax,
-  DFC_OilPSwmpSRCMin,
-  DFC_TCACDsPhysRngHi,
-  DFC_PAirFltDSRCMax,
-  DFC_PAirFltDSRCMin,
-  DFC_AirFltClogDet,
-  DFC_PEnvRngChkMax,
-  DFC_PEnvRngChkMin,
-  DFC_PEnvSnsrPlaus,
-  DFC_PEnvSigRngMax,
-  DFC_PEnvSigRngMin,
-  DFC_CEngDsTPhysRngHi,
-  DFC_CEngDsTSRCMax,
-  DFC_CEngDsTSRCMin,
-  DFC_CEngDsTNplHigh,
-  DFC_CEngDsTAbsTst,
-  DFC_CEngDsTDynTst,
-  DFC_RailPSRCMax,
-  DFC_RailPSRCMin,
-  DFC_AltIOMonPlaus,
-  DFC_BattUSRCMax,
-  DFC_BattUSRCMin,
-  DFC_FuelTPhysRngHi,
-  DFC_FuelTSRCMax,
-  DFC_FuelTSRCMin,
-  DFC_OilTPhysRngHi,
-  DFC_OilTSRCMax,
-  DFC_OilTSRCMin,
-  DFC_OilTNplHigh,
-  DFC_EpmCaSI1OfsErr,
-  DFC_EpmCaSI1ErrSig,
-  DFC_EpmCrSErrSig,
-  DFC_EpmCaSI1NoSig,
-  DFC_EpmCrSNoSig,
-  DFC_StrtCoilHSSCB,
-  DFC_GbxAliveChk,
-  DFC_BusDiagBusOffNodeA,
-  DFC_InjVlv_DI_ScCyl_0,
-  DFC_InjVlv_DI_ScHsLs_0,
-  DFC_InjVlv_DI_NoLd_0,
-  DFC_IVAdjDiaIVAdj_0,
-  DFC_InjVlv_DI_ScCyl_3,
-  DFC_InjVlv_DI_ScHsLs_3,
-  DFC_InjVlv_DI_NoLd_3,
-  DFC_IVAdjDiaIVAdj_3,
-  DFC_InjVlv_DI_ScCyl_1,
-  DFC_InjVlv_DI_ScHsLs_1,
-  DFC_InjVlv_DI_NoLd_1,
-  DFC_IVAdjDiaIVAdj_1,
-  DFC_InjVlv_DI_ScCyl_2,
-  DFC_InjVlv_DI_ScHsLs_2,
-  DFC_InjVlv_DI_NoLd_2,
-  DFC_IVAdjDiaIVAdj_2,
-  DFC_GlwPlgDiff,
-  DFC_GlwPlgLVSSCB,
-  DFC_GlwPlgLVSSCG,
-  DFC_GlwPlgLVSOL,
-  DFC_GlwPlgDiagErr,
-  DFC_GlwPlgLVSOvrTemp,
-  DFC_GlwPlg2of3,
-  DFC_StrtLSSCB,
-  DFC_StrtLSSCG,
-  DFC_StrtOL,
-  DFC_T50Err,
-  DFC_StrtLSOvrTemp,
-  DFC_ComCM1TO,
-  DFC_MeUnOL,
-  DFC_MeUnOT,
-  DFC_MeUnShCirLSBatt,
-  DFC_MeUnShCirLSGnd,
-  DFC_EngICO,
-  DFC_TECUSigRngMax,
-  DFC_TECUSigRngMin,
-  DFC_TECUPhysRngHi,
-  DFC_BusDiagBusOffNodeB,
-  DFC_PCVOL,
-  DFC_PCVOT,
-  DFC_PCVShCirLSBatt,
-  DFC_PCVShCirLSGnd,
-  DFC_EngPrtOvrSpd,
-  DFC_MRlyErlyOpng,
-  DFC_EGRVlvJamVlvOpn,
-  DFC_EGRVlvJamVlvClsd,
-  DFC_EGRVlvSRCMax,
-  DFC_EGRVlvSRCMin,
-  DFC_EGRVlvDrftOpn,
-  DFC_EGRVlvGovDvtMin,
-  DFC_EGRVlvGovDvtMax,
-  DFC_EEPWrErr,
-  DFC_EEPRdErr,
-  DFC_SSpMon1,
-  DFC_SSpMon2,
-  DFC_SSpMon3,
-  DFC_GlwPlgPLUGSC_0,
-  DFC_GlwPlgPLUGErr_0,
-  DFC_GlwPlgPLUGSC_1,
-  DFC_GlwPlgPLUGErr_1,
-  DFC_GlwPlgPLUGSC_2,
-  DFC_GlwPlgPLUGErr_2,
-  DFC_GlwPlgPLUGSC_3,
-  DFC_GlwPlgPLUGErr_3,
-  DFC_EGRVlvHBrgShCirBatt1,
-  DFC_EGRVlvHBrgShCirGnd1,
-  DFC_EGRVlvHBrgOpnLd,
-  DFC_EGRVlvHBrgOvrTemp,
-  DFC_EGRVlvHBrgShCirBatt2,
-  DFC_EGRVlvHBrgShCirGnd2,
-  DFC_StrtHSSCB,
-  DFC_StrtHSSCG,
-  DFC_StrtHSOvrTemp,
-  DFC_PSPSCB,
-  DFC_PSPSCG,
-  DFC_PSPOL,
-  DFC_PSPOvrTemp,
-  DFC_BusDiagBusOffErrPasNodeA,
-  DFC_BusDiagBusOffErrPasNodeB,
-  DFC_ComTSC1TETO,
-  DFC_RailPCV0,
-  DFC_RailPCV2,
-  DFC_RailPCV42,
-  DFC_RailPCV4,
-  DFC_InjVlv_DI_ScBnk_0,
-  DFC_InjVlv_DI_ScBnk_1,
-  DFC_RailMeUn0,
-  DFC_RailMeUn4,
-  DFC_GlwPlgUnErr,
-  DFC_GlwPlgT30Miss,
-  DFC_MoCADCTst,
-  DFC_MoCADCVltgRatio,
-  DFC_MoCComErrCnt,
-  DFC_MoCComSPI,
-  DFC_MoCROMErrXPg,
-  DFC_MoCSOPErrMMRespByte,
-  DFC_MoCSOPErrNoChk,
-  DFC_MoCSOPErrRespTime,
-  DFC_MoCSOPErrSPI,
-  DFC_MoCSOPLoLi,
-  DFC_MoCSOPMM,
-  DFC_MoCSOPOSTimeOut,
-  DFC_MoCSOPPsvTstErr,
-  DFC_MoCSOPTimeOut,
-  DFC_MoCSOPUpLi,
-  DFC_MoFAPP,
-  DFC_MoFESpd,
-  DFC_MoFInjDatET,
-  DFC_MoFInjDatPhi,
-  DFC_MoFInjQnt,
-  DFC_MoFMode2,
-  DFC_MoFMode3,
-  DFC_MoFOvR,
-  DFC_MoFOvRHtPrt,
-  DFC_MoFQntCor,
-  DFC_MoFRailP,
-  DFC_MoFRmtAPP,
-  DFC_MoFTrqCmp,
-  DFC_MonLimCurr,
-  DFC_MonLimLead,
-  DFC_MonLimSet,
-  DFC_MoFInjDatBlkShtET,
-  DFC_OCWDACom_ERR,
-  DFC_OCWDALowVltg,
-  DFC_OCWDAOvrVltg,
-  DFC_OCWDAReasUnkwn,
-  DFC_RailMeUn10,
-  DFC_RailMeUn2,
-  DFC_SWReset_0,
-  DFC_SWReset_1,
-  DFC_SWReset_2,
-  DFC_MoCADCNTP,
-  DFC_MoFStrt,
-  DFC_Cy327SpiCom,
-  NUM_DTC_CODES // Special value to represent the total number of DTC codes
-};
+static_assert(sizeof(rbr_isobus_dtc_ts) == 4, "rbr_isobus_dtc_ts has to stay one packed 32-bit word");
 
+constexpr rbr_isobus_dtc_ts DtcMake(uint32_t spn, uint8_t fmi, uint8_t occ)
+{
+  return { (spn & MASK_DTC_SPN) | ((uint32_t)(fmi & MASK_DTC_FMI) << SHIFT_DTC_FMI) | ((uint32_t)(occ & MASK_DTC_OCC) << SHIFT_DTC_OCC) };
+}
 
+constexpr uint32_t DtcSpn(rbr_isobus_dtc_ts dtc) { return dtc.word & MASK_DTC_SPN; }
+constexpr uint8_t DtcFmi(rbr_isobus_dtc_ts dtc) { return (dtc.word >> SHIFT_DTC_FMI) & MASK_DTC_FMI; }
+constexpr uint8_t DtcOcc(rbr_isobus_dtc_ts dtc) { return (dtc.word >> SHIFT_DTC_OCC) & MASK_DTC_OCC; }
+constexpr bool DtcCm(rbr_isobus_dtc_ts dtc) { return (dtc.word >> SHIFT_DTC_CM) != 0; }
+constexpr uint32_t DtcKey(uint32_t spn, uint8_t fmi) { return DtcMake(spn, fmi, 0).word; }
 
+void DtcSetOcc(rbr_isobus_dtc_ts* dtc, uint8_t occ)
+{
+  dtc->word = (dtc->word & ~((uint32_t)MASK_DTC_OCC << SHIFT_DTC_OCC)) | ((uint32_t)(occ & MASK_DTC_OCC) << SHIFT_DTC_OCC);
+}
 
+static_assert(DtcSpn(DtcMake(MASK_DTC_SPN, 0, 0)) == MASK_DTC_SPN && DtcFmi(DtcMake(0, MASK_DTC_FMI, 0)) == MASK_DTC_FMI
+  && DtcOcc(DtcMake(0, 0, MASK_DTC_OCC)) == MASK_DTC_OCC && DtcMake(MASK_DTC_SPN, MASK_DTC_FMI, 0).word == MASK_DTC_KEY, "DTC fields overlap");
 
+#include "dtc_codes.h"
 
-// DM1/DM2 CODES
-rbr_isobus_dtc_ts dtc_info_array[NUM_DTC_CODES] = {
-    {.spn_u32 = 27, .fmi_u8 = 17, .occ_u8 = 0},              // EGR Valve
-    {.spn_u32 = 94, .fmi_u8 = 13, .occ_u8 = 0},                    // Low fuel pressure error monitoring
-    {.spn_u32 = 95, .fmi_u8 = 3, .occ_u8 = 0},                  // SRC High for Environment Pressure
-    {.spn_u32 = 95, .fmi_u8 = 4, .occ_u8 = 0},                  // SRC low for Environment Pressure
-    {.spn_u32 = 97, .fmi_u8 = 15, .occ_u8 = 0},                 // Water in fuel detected
-    {.spn_u32 = 100, .fmi_u8 = 0, .occ_u8 = 0},           // Maximum oil pressure error in plausibility check
-    {.spn_u32 = 100, .fmi_u8 = 1, .occ_u8 = 0},           // Minimum oil pressure error in plausibility check
-    {.spn_u32 = 100, .fmi_u8 = 3, .occ_u8 = 0},              // SRC high for oil pressure sensor
-    {.spn_u32 = 100, .fmi_u8 = 0, .occ_u8 = 0},              // SRC low for Oil pressure sensor
-    {.spn_u32 = 105, .fmi_u8 = 17, .occ_u8 = 0},            // Physical Range Check high for Charged Air cooler down stream temperature
-    {.spn_u32 = 107, .fmi_u8 = 3, .occ_u8 = 0},              // SRC High for Controller Mode Switch
-    {.spn_u32 = 107, .fmi_u8 = 4, .occ_u8 = 0},              // SRC low for Controller Mode Switch
-    {.spn_u32 = 107, .fmi_u8 = 14, .occ_u8 = 0},              // Error path for Clog Detection in Air filter
-    {.spn_u32 = 108, .fmi_u8 = 0, .occ_u8 = 0},               // Ambient air pressure sensor range chack max-error
-    {.spn_u32 = 108, .fmi_u8 = 1, .occ_u8 = 0},               // Ambient air pressure sensor range check min-error
-    {.spn_u32 = 108, .fmi_u8 = 2, .occ_u8 = 0},               // Ambient air pressure sensor sensor error by component self diagnosis
-    {.spn_u32 = 108, .fmi_u8 = 3, .occ_u8 = 0},               // fault check max signal range violated for ambient air pressure sensor
-    {.spn_u32 = 108, .fmi_u8 = 4, .occ_u8 = 0},               // fault check min signal range violated for ambient air pressure sensor
-    {.spn_u32 = 110, .fmi_u8 = 0, .occ_u8 = 0},            // Physical Range Check high for CEngDsT
-    {.spn_u32 = 110, .fmi_u8 = 3, .occ_u8 = 0},               // SRC High for Engine coolant temperature(down stream)
-    {.spn_u32 = 110, .fmi_u8 = 4, .occ_u8 = 0},               // SRC low for Engine coolant temperature(down stream)
-    {.spn_u32 = 110, .fmi_u8 = 16, .occ_u8 = 0},             // Engine coolant temperature too high plausibility error
-    {.spn_u32 = 110, .fmi_u8 = 17, .occ_u8 = 0},              // defect fault check for Absolute plausibility test
-    {.spn_u32 = 110, .fmi_u8 = 18, .occ_u8 = 0},              // defect fault check for dynamic plausibility test
-    {.spn_u32 = 157, .fmi_u8 = 3, .occ_u8 = 0},                 // Sensor voltage above upper limit
-    {.spn_u32 = 157, .fmi_u8 = 4, .occ_u8 = 0},                 // Sensor voltage below lower limit
-    {.spn_u32 = 167, .fmi_u8 = 7, .occ_u8 = 0},               // Plausibility check for input signal for monitoring the alternator
-    {.spn_u32 = 168, .fmi_u8 = 3, .occ_u8 = 0},                 // Diagnostic Fault Check for Signal Range Max Check of Battery Voltage
-    {.spn_u32 = 168, .fmi_u8 = 4, .occ_u8 = 0},                 // Diagnostic Fault Check for Signal Range Min Check of Battery Voltage
-    {.spn_u32 = 174, .fmi_u8 = 0, .occ_u8 = 0},              // Physical Range Check high for fuel temperature
-    {.spn_u32 = 174, .fmi_u8 = 3, .occ_u8 = 0},                 // SRC high for fuel temperature sensor
-    {.spn_u32 = 174, .fmi_u8 = 4, .occ_u8 = 0},                 // SRC low for fuel temperature sensor
-    {.spn_u32 = 175, .fmi_u8 = 0, .occ_u8 = 0},               // Physical Range Check high for Oil Temperature
-    {.spn_u32 = 175, .fmi_u8 = 3, .occ_u8 = 0},                  // SRC High for Oil Temperature
-    {.spn_u32 = 175, .fmi_u8 = 4, .occ_u8 = 0},                  // SRC low for Oil Temperature
-    {.spn_u32 = 175, .fmi_u8 = 13, .occ_u8 = 0},                // Oil temperature too high plausibility error
-    {.spn_u32 = 190, .fmi_u8 = 2, .occ_u8 = 0},              // DFC for camshaft offset angle exceeded
-    {.spn_u32 = 190, .fmi_u8 = 8, .occ_u8 = 0},              // DFC for camshaft signal diagnose - disturbed signal
-    {.spn_u32 = 190, .fmi_u8 = 9, .occ_u8 = 0},                // DFC for crankshaft signal diagnose - disturbed signal
-    {.spn_u32 = 190, .fmi_u8 = 12, .occ_u8 = 0},              // DFC for camshaft signal diagnose - no signal
-    {.spn_u32 = 190, .fmi_u8 = 18, .occ_u8 = 0},                // DFC for crankshaft signal diagnose - no signal
-    {.spn_u32 = 430, .fmi_u8 = 3, .occ_u8 = 0},               // Short circuit to battery error at High side of coil in Inhibit starter strategy
-    {.spn_u32 = 604, .fmi_u8 = 2, .occ_u8 = 0},                 // Alive Detection for Gbx_stNPos
-    {.spn_u32 = 639, .fmi_u8 = 14, .occ_u8 = 0},         // BusOff error CAN A
-    {.spn_u32 = 651, .fmi_u8 = 3, .occ_u8 = 0},           // Short circuit of the power stage low-side (cylinder error)
-    {.spn_u32 = 651, .fmi_u8 = 4, .occ_u8 = 0},          // Short circuit between high-side and low-side of the power stage (high-side non plausible error)
-    {.spn_u32 = 651, .fmi_u8 = 5, .occ_u8 = 0},            // Open load on the power stage
-    {.spn_u32 = 651, .fmi_u8 = 13, .occ_u8 = 0},            // check of missing injector adjustment value programming
-    {.spn_u32 = 652, .fmi_u8 = 3, .occ_u8 = 0},           // Short circuit of the power stage low-side (cylinder error)
-    {.spn_u32 = 652, .fmi_u8 = 4, .occ_u8 = 0},          // Short circuit between high-side and low-side of the power stage (high-side non plausible error)
-    {.spn_u32 = 652, .fmi_u8 = 5, .occ_u8 = 0},            // Open load on the power stage
-    {.spn_u32 = 652, .fmi_u8 = 13, .occ_u8 = 0},            // check of missing injector adjustment value programming
-    {.spn_u32 = 653, .fmi_u8 = 3, .occ_u8 = 0},           // Short circuit of the power stage low-side (cylinder error)
-    {.spn_u32 = 653, .fmi_u8 = 4, .occ_u8 = 0},          // Short circuit between high-side and low-side of the power stage (high-side non plausible error)
-    {.spn_u32 = 653, .fmi_u8 = 5, .occ_u8 = 0},            // Open load on the power stage
-    {.spn_u32 = 653, .fmi_u8 = 13, .occ_u8 = 0},            // check of missing injector adjustment value programming
-    {.spn_u32 = 654, .fmi_u8 = 3, .occ_u8 = 0},           // Short circuit of the power stage low-side (cylinder error)
-    {.spn_u32 = 654, .fmi_u8 = 4, .occ_u8 = 0},          // Short circuit between high-side and low-side of the power stage (high-side non plausible error)
-    {.spn_u32 = 654, .fmi_u8 = 5, .occ_u8 = 0},            // Open load on the power stage
-    {.spn_u32 = 654, .fmi_u8 = 13, .occ_u8 = 0},            // check of missing injector adjustment value programming
-    {.spn_u32 = 676, .fmi_u8 = 2, .occ_u8 = 0},                  // DFC for coding error when different coding words were received in a coding cycle
-    {.spn_u32 = 676, .fmi_u8 = 3, .occ_u8 = 0},                // Short circuit to battery error for Low Voltage System
-    {.spn_u32 = 676, .fmi_u8 = 4, .occ_u8 = 0},                // Short circuit to ground error for Low Voltage System
-    {.spn_u32 = 676, .fmi_u8 = 5, .occ_u8 = 0},                 // No load error for Low Voltage System
-    {.spn_u32 = 676, .fmi_u8 = 11, .occ_u8 = 0},              // DFC for faulty diagnostic data transmission or protocol error
-    {.spn_u32 = 676, .fmi_u8 = 12, .occ_u8 = 0},           // Over temperature error on ECU powerstage for Glow plug Low Voltage System
-    {.spn_u32 = 676, .fmi_u8 = 21, .occ_u8 = 0},                 // DFC for coding error when selected coding is not working
-    {.spn_u32 = 677, .fmi_u8 = 3, .occ_u8 = 0},                   // Short circuit to battery error for Starter low side
-    {.spn_u32 = 677, .fmi_u8 = 4, .occ_u8 = 0},                   // Short circuit to ground error for Starter low side
-    {.spn_u32 = 677, .fmi_u8 = 5, .occ_u8 = 0},                      // No load error for Starter
-    {.spn_u32 = 677, .fmi_u8 = 10, .occ_u8 = 0},                     // Defective T50 switch
-    {.spn_u32 = 677, .fmi_u8 = 12, .occ_u8 = 0},              // Over temperature error for Starter low side
-    {.spn_u32 = 986, .fmi_u8 = 9, .occ_u8 = 0},                    // Timeout Error of CAN-Receive-Frame Cab Message 1
-    {.spn_u32 = 1076, .fmi_u8 = 5, .occ_u8 = 0},                     // open load of metering unit output
-    {.spn_u32 = 1076, .fmi_u8 = 12, .occ_u8 = 0},                    // over teperature of device driver of metering unit
-    {.spn_u32 = 1076, .fmi_u8 = 16, .occ_u8 = 0},           // short circuit to battery of metering unit output
-    {.spn_u32 = 1076, .fmi_u8 = 18, .occ_u8 = 0},            // short circuit to ground of metering unit output
-    {.spn_u32 = 1109, .fmi_u8 = 11, .occ_u8 = 0},                    // Injection cut off demand (ICO) for shut off coordinator
-    {.spn_u32 = 1136, .fmi_u8 = 0, .occ_u8 = 0},              // ECU Temperature Sensor MAX
-    {.spn_u32 = 1136, .fmi_u8 = 1, .occ_u8 = 0},              // ECU Temperature Sensor MIN
-    {.spn_u32 = 1136, .fmi_u8 = 16, .occ_u8 = 0},             // Diagnostic Fault Check for Physical Signal above maximum limit
-    {.spn_u32 = 1231, .fmi_u8 = 14, .occ_u8 = 0},        // BusOff error CAN B
-    {.spn_u32 = 1244, .fmi_u8 = 5, .occ_u8 = 0},                      // open load of pressure control valve output
-    {.spn_u32 = 1244, .fmi_u8 = 12, .occ_u8 = 0},                     // over teperature of device driver of pressure control valve
-    {.spn_u32 = 1244, .fmi_u8 = 16, .occ_u8 = 0},            // short circuit to battery of pressure control valve output
-    {.spn_u32 = 1244, .fmi_u8 = 18, .occ_u8 = 0},             // short circuit to ground of the pressure control valve output
-    {.spn_u32 = 1769, .fmi_u8 = 11, .occ_u8 = 0},              // Overspeed detection in component engine protection
-    {.spn_u32 = 2634, .fmi_u8 = 11, .occ_u8 = 0},              // Early opening defect of main relay
-    {.spn_u32 = 2791, .fmi_u8 = 0, .occ_u8 = 0},            // EGR Valve OPEN
-    {.spn_u32 = 2791, .fmi_u8 = 1, .occ_u8 = 0},           // EGR Valve CLOSED
-    {.spn_u32 = 2791, .fmi_u8 = 13, .occ_u8 = 0},              // EGR Valve SCR MAX
-    {.spn_u32 = 2791, .fmi_u8 = 14, .occ_u8 = 0},              // EGR Valve SCR MIN
-    {.spn_u32 = 2791, .fmi_u8 = 15, .occ_u8 = 0},             // EGR Valve DRFT OPEN
-    {.spn_u32 = 2791, .fmi_u8 = 16, .occ_u8 = 0},           // EGR Valve GOV DVT MIN
-    {.spn_u32 = 2791, .fmi_u8 = 18, .occ_u8 = 0},           // EGR Valve GOV DVT MAX
-    {.spn_u32 = 2802, .fmi_u8 = 12, .occ_u8 = 0},                  // EEP Write Error based on the error in storing the blocks in memory media
-    {.spn_u32 = 2802, .fmi_u8 = 14, .occ_u8 = 0},                  // EEP Read Error based on the error in reading blocks from memory media
-    {.spn_u32 = 3509, .fmi_u8 = 2, .occ_u8 = 0},                    // Voltage fault at Sensor supply 1
-    {.spn_u32 = 3510, .fmi_u8 = 2, .occ_u8 = 0},                    // Voltage fault at Sensor supply 2
-    {.spn_u32 = 3511, .fmi_u8 = 2, .occ_u8 = 0},                    // Voltage fault at Sensor supply 3
-    {.spn_u32 = 5324, .fmi_u8 = 4, .occ_u8 = 0},             // Array of DFCs for short circuit in i+1th Glow Plug
-    {.spn_u32 = 5324, .fmi_u8 = 11, .occ_u8 = 0},           // Array of DFCs for failure in i+1th Glow Plug
-    {.spn_u32 = 5325, .fmi_u8 = 4, .occ_u8 = 0},             // Array of DFCs for short circuit in i+1th Glow Plug
-    {.spn_u32 = 5325, .fmi_u8 = 11, .occ_u8 = 0},           // Array of DFCs for failure in i+1th Glow Plug
-    {.spn_u32 = 5326, .fmi_u8 = 4, .occ_u8 = 0},             // Array of DFCs for short circuit in i+1th Glow Plug
-    {.spn_u32 = 5326, .fmi_u8 = 11, .occ_u8 = 0},           // Array of DFCs for failure in i+1th Glow Plug
-    {.spn_u32 = 5327, .fmi_u8 = 4, .occ_u8 = 0},             // Array of DFCs for short circuit in i+1th Glow Plug
-    {.spn_u32 = 5327, .fmi_u8 = 11, .occ_u8 = 0},           // Array of DFCs for failure in i+1th Glow Plug
-    {.spn_u32 = 5763, .fmi_u8 = 33, .occ_u8 = 0},      // EGR VALVE
-    {.spn_u32 = 5763, .fmi_u8 = 4, .occ_u8 = 0},        // EGR VALVE
-    {.spn_u32 = 5763, .fmi_u8 = 5, .occ_u8 = 0},            // EGR VALVE
-    {.spn_u32 = 5763, .fmi_u8 = 12, .occ_u8 = 0},         // EGR VALVE
-    {.spn_u32 = 5770, .fmi_u8 = 3, .occ_u8 = 0},       // EGR VALVE
-    {.spn_u32 = 5770, .fmi_u8 = 4, .occ_u8 = 0},        // EGR VALVE
-    {.spn_u32 = 6385, .fmi_u8 = 3, .occ_u8 = 0},                  // Short circuit to battery error for Starter high side
-    {.spn_u32 = 6385, .fmi_u8 = 4, .occ_u8 = 0},                  // Short circuit to ground error for Starter high side
-    {.spn_u32 = 6385, .fmi_u8 = 12, .occ_u8 = 0},             // Over temperature error for Starter high side
-    {.spn_u32 = 6719, .fmi_u8 = 3, .occ_u8 = 0},                     // short circuit to battery of pre-supply pump output
-    {.spn_u32 = 6719, .fmi_u8 = 4, .occ_u8 = 0},                     // short circuit to ground of pre-supply pump output
-    {.spn_u32 = 6719, .fmi_u8 = 5, .occ_u8 = 0},                      // open load of pre-supply pump output
-    {.spn_u32 = 6719, .fmi_u8 = 12, .occ_u8 = 0},                // Over temperature error on ECU powerstage for Pre supply pump
-    {.spn_u32 = 22000, .fmi_u8 = 14, .occ_u8 = 0}, // error passive CAN A
-    {.spn_u32 = 22001, .fmi_u8 = 15, .occ_u8 = 0}, // error passive CAN B
-    {.spn_u32 = 22040, .fmi_u8 = 19, .occ_u8 = 0},              // Timeout Error of CAN-Receive-Frame TSC1TE
-    {.spn_u32 = 523037, .fmi_u8 = 0, .occ_u8 = 0},                 // maximum positive deviation of rail pressure exceeded
-    {.spn_u32 = 523040, .fmi_u8 = 0, .occ_u8 = 0},                 // maximum negative rail pressure deviation with closed pressure control valve exceeded
-    {.spn_u32 = 523042, .fmi_u8 = 0, .occ_u8 = 0},                // maximum rail pressure exceeded (second stage)
-    {.spn_u32 = 523043, .fmi_u8 = 0, .occ_u8 = 0},                 // maximum rail pressure exceeded
-    {.spn_u32 = 523350, .fmi_u8 = 4, .occ_u8 = 0},        // Short circuit of the power stage high-side (bank error)
-    {.spn_u32 = 523352, .fmi_u8 = 4, .occ_u8 = 0},        // Short circuit of the power stage high-side (bank error)
-    {.spn_u32 = 523613, .fmi_u8 = 0, .occ_u8 = 0},                // maximum positive deviation of rail pressure exceeded
-    {.spn_u32 = 523613, .fmi_u8 = 16, .occ_u8 = 0},               // maximum rail pressure exceeded
-    {.spn_u32 = 523676, .fmi_u8 = 12, .occ_u8 = 0},             // DFC for glow module error in GCU-T
-    {.spn_u32 = 523676, .fmi_u8 = 16, .occ_u8 = 0},           // DFC for T30 missing error in GCU-T
-    {.spn_u32 = 524059, .fmi_u8 = 12, .occ_u8 = 0},               // Diagnostic fault check to report the ADC test error
-    {.spn_u32 = 524060, .fmi_u8 = 12, .occ_u8 = 0},         // Diagnostic fault check to report the error in Voltage ratio in ADC monitoring
-    {.spn_u32 = 524061, .fmi_u8 = 12, .occ_u8 = 0},            // Diagnostic fault check to report errors in query-/response-communication
-    {.spn_u32 = 524062, .fmi_u8 = 12, .occ_u8 = 0},               // Diagnostic fault check to report errors in SPI-communication
-    {.spn_u32 = 524063, .fmi_u8 = 12, .occ_u8 = 0},            // Diagnostic fault check to report multiple error while checking the complete ROM-memory
-    {.spn_u32 = 524064, .fmi_u8 = 12, .occ_u8 = 0},     // Loss of synchronization sending bytes to the MM from CPU.
-    {.spn_u32 = 524065, .fmi_u8 = 12, .occ_u8 = 0},          // DFC to set a torque limitation once an error is detected before MoCSOP's error reaction is set
-    {.spn_u32 = 524066, .fmi_u8 = 12, .occ_u8 = 0},       // Wrong set response time
-    {.spn_u32 = 524067, .fmi_u8 = 12, .occ_u8 = 0},            // Too many SPI errors during MoCSOP execution.
-    {.spn_u32 = 524068, .fmi_u8 = 12, .occ_u8 = 0},              // Diagnostic fault check to report the error in undervoltage monitoring
-    {.spn_u32 = 524069, .fmi_u8 = 12, .occ_u8 = 0},                // Diagnostic fault check to report that WDA is not working correct
-    {.spn_u32 = 524070, .fmi_u8 = 12, .occ_u8 = 0},         // OS timeout in the shut off path test. Failure setting the alarm task period.
-    {.spn_u32 = 524071, .fmi_u8 = 12, .occ_u8 = 0},         // Diagnostic fault check to report that the positive test failed
-    {.spn_u32 = 524072, .fmi_u8 = 12, .occ_u8 = 0},           // Diagnostic fault check to report the timeout in the shut off path test
-    {.spn_u32 = 524073, .fmi_u8 = 12, .occ_u8 = 0},              // Diagnostic fault check to report the error in overvoltage monitoring
-    {.spn_u32 = 524074, .fmi_u8 = 12, .occ_u8 = 0},                  // Diagnostic fault check to report the accelerator pedal position error
-    {.spn_u32 = 524075, .fmi_u8 = 12, .occ_u8 = 0},                 // Diagnostic fault check to report the engine speed error
-    {.spn_u32 = 524076, .fmi_u8 = 12, .occ_u8 = 0},             // Diagnostic fault check to report the plausibility error between level 1 energizing time and level 2 information
-    {.spn_u32 = 524077, .fmi_u8 = 12, .occ_u8 = 0},            // Diagnostic fault check to report the error due to plausibility between the injection begin v/s injection type
-    {.spn_u32 = 524078, .fmi_u8 = 12, .occ_u8 = 0},               // Diagnostic fault check to report the error due to non plausibility in ZFC
-    {.spn_u32 = 524080, .fmi_u8 = 12, .occ_u8 = 0},                // Diagnosis fault check to report the error to demand for an ICO due to an error in the PoI2 shut-off
-    {.spn_u32 = 524081, .fmi_u8 = 12, .occ_u8 = 0},                // Diagnosis fault check to report the error to demand for an ICO due to an error in the PoI3 efficiency factor
-    {.spn_u32 = 524082, .fmi_u8 = 12, .occ_u8 = 0},                  // Diagnostic fault check to report the error due to Over Run
-    {.spn_u32 = 524083, .fmi_u8 = 12, .occ_u8 = 0},             // Diagnostic fault check to report the error due to cooling injection in Over Run
-    {.spn_u32 = 524084, .fmi_u8 = 12, .occ_u8 = 0},               // Diagnostic fault check to report the error due to injection quantity correction
-    {.spn_u32 = 524085, .fmi_u8 = 12, .occ_u8 = 0},                // Diagnostic fault check to report the plausibility error in rail pressure monitoring
-    {.spn_u32 = 524086, .fmi_u8 = 12, .occ_u8 = 0},               // Diagnostic fault check to report the remote accelerator pedal position error
-    {.spn_u32 = 524087, .fmi_u8 = 12, .occ_u8 = 0},               // Diagnostic fault check to report the error due to torque comparison
-    {.spn_u32 = 524088, .fmi_u8 = 12, .occ_u8 = 0},              // Diagnosis of curr path limitation forced by ECU monitoring level 2
-    {.spn_u32 = 524089, .fmi_u8 = 12, .occ_u8 = 0},              // Diagnosis of lead path limitation forced by ECU monitoring level 2
-    {.spn_u32 = 524090, .fmi_u8 = 12, .occ_u8 = 0},               // Diagnosis of set path limitation forced by ECU monitoring level 2
-    {.spn_u32 = 524093, .fmi_u8 = 12, .occ_u8 = 0},       // Diagnostic fault check to report the plausibility error for Blankshot injection
-    {.spn_u32 = 524098, .fmi_u8 = 12, .occ_u8 = 0},            // Not the same name cuz it exists elsewhere.. Diagnostic fault check to report "WDA active" due to errors in query-/response communication
-    {.spn_u32 = 524099, .fmi_u8 = 12, .occ_u8 = 0},            // Diagnostic fault check to report "ABE active" due to undervoltage detection
-    {.spn_u32 = 524100, .fmi_u8 = 12, .occ_u8 = 0},            // Diagnostic fault check to report "ABE active" due to overvoltage detection
-    {.spn_u32 = 524101, .fmi_u8 = 12, .occ_u8 = 0},          // Diagnostic fault check to report "WDA/ABE active" due to unknown reason
-    {.spn_u32 = 524104, .fmi_u8 = 0, .occ_u8 = 0},               // leakage is detected based on fuel quantity balance
-    {.spn_u32 = 524105, .fmi_u8 = 0, .occ_u8 = 0},                // maximum negative rail pressure deviation with metering unit on lower limit is exceeded
-    {.spn_u32 = 524120, .fmi_u8 = 14, .occ_u8 = 0},               // Visibility of SoftwareResets in DSM
-    {.spn_u32 = 524121, .fmi_u8 = 14, .occ_u8 = 0},               // Visibility of SoftwareResets in DSM
-    {.spn_u32 = 524122, .fmi_u8 = 14, .occ_u8 = 0},               // Visibility of SoftwareResets in DSM
-    {.spn_u32 = 524124, .fmi_u8 = 12, .occ_u8 = 0},               // Diagnostic fault check to report the NTP error in ADC monitoring
-    {.spn_u32 = 524128, .fmi_u8 = 12, .occ_u8 = 0},                 // function monitoring: fault in the monitoring of the start control
-    {.spn_u32 = 524131, .fmi_u8 = 12, .occ_u8 = 0}              // CY327 SPI Communication Error
-};
+// every (spn, fmi) only once and every SPN/FMI in range, otherwise GetIndexOfDM1() finds the wrong entry
+constexpr bool DtcTableIsValid(const rbr_isobus_dtc_ts dtcs[], int len)
+{
+  int i;
+  for (i = 0; i < len; i++)
+  {
+    if (DtcOcc(dtcs[i]) != 0 || DtcCm(dtcs[i]))
+      return false;
+    int j;
+    for (j = i + 1; j < len; j++)
+    {
+      if ((dtcs[i].word & MASK_DTC_KEY) == (dtcs[j].word & MASK_DTC_KEY))
+        return false;
+    }
+  }
+  return true;
+}
+
+static_assert(DtcTableIsValid(dtc_info_array, NUM_DTC_CODES), "dtc_info_array has duplicate SPN/FMI pairs, fix dtc_codes.csv");
+
+// (spn, fmi) -> DTC_Codes without scanning: open addressing over the packed keys, built at compile time
+#define DTC_INDEX_BITS 9
+#define DTC_INDEX_SIZE (1 << DTC_INDEX_BITS)
+#define DTC_INDEX_EMPTY 0xFFFFFFFFu // can't be a key, keys are 24 bits
+
+typedef struct dtc_index_t
+{
+  uint32_t keys[DTC_INDEX_SIZE];
+  int16_t codes[DTC_INDEX_SIZE];
+} dtc_index_ts;
+
+static_assert(NUM_DTC_CODES <= DTC_INDEX_SIZE / 2, "DTC index over 50% full, raise DTC_INDEX_BITS");
+
+constexpr uint32_t DtcIndexSlot(uint32_t key)
+{
+  return (key * 0x9E3779B1u) >> (32 - DTC_INDEX_BITS); // fibonacci hashing, like the PGN routing table
+}
+
+constexpr dtc_index_ts DtcIndexBuild()
+{
+  dtc_index_ts index = {};
+  int i;
+  for (i = 0; i < DTC_INDEX_SIZE; i++)
+  {
+    index.keys[i] = DTC_INDEX_EMPTY;
+    index.codes[i] = -1;
+  }
+  for (i = 0; i < NUM_DTC_CODES; i++)
+  {
+    uint32_t key = dtc_info_array[i].word & MASK_DTC_KEY;
+    uint32_t slot = DtcIndexSlot(key);
+    while (index.keys[slot] != DTC_INDEX_EMPTY)
+      slot = (slot + 1) & (DTC_INDEX_SIZE - 1);
+    index.keys[slot] = key;
+    index.codes[slot] = (int16_t)i;
+  }
+  return index;
+}
+
+constexpr dtc_index_ts DTC_INDEX = DtcIndexBuild();
 
+// DTC_Codes index of (spn, fmi), -1 if it isn't in dtc_info_array. Same result as GetIndexOfDM1() on dtc_info_array
+int16_t DtcIndexLookup(uint32_t spn, uint8_t fmi)
+{
+  uint32_t key = DtcKey(spn, fmi);
+  uint32_t slot = DtcIndexSlot(key);
+  while (DTC_INDEX.keys[slot] != DTC_INDEX_EMPTY)
+  {
+    if (DTC_INDEX.keys[slot] == key)
+      return DTC_INDEX.codes[slot];
+    slot = (slot + 1) & (DTC_INDEX_SIZE - 1);
+  }
+  return -1;
+}
 
 // just a linear search function - takes at most 12us to complete at 180 searchable indexes
-int16_t GetIndexOfDM1(uint32_t spn, uint8_t fmi, rbr_isobus_dtc_ts dtcs[], uint16_t len)
+int16_t GetIndexOfDM1(uint32_t spn, uint8_t fmi, const rbr_isobus_dtc_ts dtcs[], uint16_t len)
 {
+  uint32_t key = DtcKey(spn, fmi);
   int i;
   for (i = 0; i < len; i++)
   {
-    if (spn == dtcs[i].spn_u32 && fmi == dtcs[i].fmi_u8)
+    if ((dtcs[i].word & MASK_DTC_KEY) == key)
     {
       return i;
     }
@@ -519,7 +454,7 @@ void EncodeDTCMessages(rbr_isobus_dtc_ts listDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16]
   int i;
   for (i = 0; i < RBR_ISOBUS_DTC_LIST_SIZE_DU16; i++)
   {
-    int16_t output = GetIndexOfDM1(listDTCs[i].spn_u32, listDTCs[i].fmi_u8, dtc_info_array, NUM_DTC_CODES);
+    int16_t output = DtcIndexLookup(DtcSpn(listDTCs[i]), DtcFmi(listDTCs[i]));
     //if (output != -1)
     encDTCs[i] = output;
   }
@@ -527,13 +462,14 @@ void EncodeDTCMessages(rbr_isobus_dtc_ts listDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16]
 
 void SerializeDTCMessages(uint8_t lamps, rbr_isobus_dtc_ts listDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16], uint8_t numDTCs, uint8_t encodedMessages[MAX_NUM_ENC_DTC_MSGS][MAX_NUM_BYTES_PER_DTC_MSG], uint8_t* numEncodedMessages)
 {
+  TRACE_SCOPE(TRACE_SERIALIZE_DTC);
   uint16_t encDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16] = { 0 };
   EncodeDTCMessages(listDTCs, encDTCs);
 
   uint64_t encMsg;
   *numEncodedMessages = 1 + (numDTCs / MAX_NUM_DTCS_PER_ENC_MSG); // up to 20 DTCs can be stored from bds, so send up to 4 messages of 5 DTCs each.
   int i;
-  for (i = 0; i < MAX_NUM_DTCS_PER_ENC_MSG; i++)
+  for (i = 0; i < MAX_NUM_ENC_DTC_MSGS; i++)
   {
     encMsg = 0; // start off clean
     encMsg |= (uint64_t)(i & MASK_2LSB) << SHIFT_MSG_NUM;
@@ -552,304 +488,5159 @@ void SerializeDTCMessages(uint8_t lamps, rbr_isobus_dtc_ts listDTCs[RBR_ISOBUS_D
   }
 }
 
-void DecodeDTCMessages(uint16_t encDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16], rbr_isobus_dtc_ts decDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16])
+void DecodeDTCMessages(uint16_t encDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16], rbr_isobus_dtc_ts decDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16])
+{
+  int i;
+  for (i = 0; i < RBR_ISOBUS_DTC_LIST_SIZE_DU16; i++)
+  {
+    if (encDTCs[i] != (uint16_t)(-1))
+      decDTCs[i] = dtc_info_array[encDTCs[i]];
+  }
+}
+
+void ParseDTCMessages(uint8_t* lamps, uint8_t encodedMessages[MAX_NUM_ENC_DTC_MSGS][MAX_NUM_BYTES_PER_DTC_MSG], uint8_t numEncodedMessages, rbr_isobus_dtc_ts listDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16], uint8_t* numDTCs)
+{
+  TRACE_SCOPE(TRACE_PARSE_DTC);
+  uint16_t encDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16];
+  uint64_t encMsg = 0;
+  int i;
+  for (i = 0; i < MAX_NUM_ENC_DTC_MSGS; i++)
+  {
+    encMsg = 0;
+    int j;
+    for (j = 0; j < MAX_NUM_BYTES_PER_DTC_MSG; j++)
+    {
+      encMsg |= (uint64_t)encodedMessages[i][j] << (SHIFT_8b * j); // Converting to a 64-bit num makes parsing easier
+    }
+    *numDTCs |= (uint64_t)(i & MASK_2LSB) << SHIFT_MSG_NUM;
+    *lamps = (encMsg >> SHIFT_DTC_LAMPS) & MASK_4LSB;
+    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 0] = (encMsg >> SHIFT_DTC_MSG_1) & MASK_10LSB;
+    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 1] = (encMsg >> SHIFT_DTC_MSG_2) & MASK_10LSB;
+    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 2] = (encMsg >> SHIFT_DTC_MSG_3) & MASK_10LSB;
+    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 3] = (encMsg >> SHIFT_DTC_MSG_4) & MASK_10LSB;
+    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 4] = (encMsg >> SHIFT_DTC_MSG_5) & MASK_10LSB;
+  }
+  DecodeDTCMessages(encDTCs, listDTCs);
+}
+
+//---------------------------------------------------------------------------------------------------------
+// ACTIVE DTC LIST
+// What the application reports as active, in the same format SerializeDTCMessages() / DmPrepareTransmit()
+// take, so it can be sent as is. Reporting an already active DTC only counts up its occurrence counter.
+// Checks on several decode threads can report at the same time, so the list has a small spin lock;
+// reports are rare (a check failed), the checks themselves never touch it.
+//---------------------------------------------------------------------------------------------------------
+#define DTC_MAX_OCC 126 // J1939-73: 127 = not available
+
+rbr_isobus_dtc_ts activeDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16];
+uint8_t numActiveDTCs = 0;
+std::atomic_flag activeDTCsLock = ATOMIC_FLAG_INIT;
+
+/**
+ * @brief Marks a DTC from dtc_info_array as active.
+ *
+ * @param code DTC_Codes index
+ * @return 0 on success, -1 if code is out of range or the active list is full
+ */
+int ReportDTC(int code)
+{
+  if (code < 0 || code >= NUM_DTC_CODES)
+    return -1;
+  while (activeDTCsLock.test_and_set(std::memory_order_acquire))
+  {
+  }
+  int result = 0;
+  int16_t index = GetIndexOfDM1(DtcSpn(dtc_info_array[code]), DtcFmi(dtc_info_array[code]), activeDTCs, numActiveDTCs);
+  if (index >= 0)
+  {
+    if (DtcOcc(activeDTCs[index]) < DTC_MAX_OCC)
+      DtcSetOcc(&activeDTCs[index], DtcOcc(activeDTCs[index]) + 1);
+  }
+  else if (numActiveDTCs < RBR_ISOBUS_DTC_LIST_SIZE_DU16)
+  {
+    activeDTCs[numActiveDTCs] = dtc_info_array[code];
+    DtcSetOcc(&activeDTCs[numActiveDTCs], 1);
+    numActiveDTCs++;
+  }
+  else
+    result = -1;
+  activeDTCsLock.clear(std::memory_order_release);
+  return result;
+}
+
+// removes a DTC from the active list (it healed). -1 if it wasn't active
+int ClearDTC(int code)
+{
+  if (code < 0 || code >= NUM_DTC_CODES)
+    return -1;
+  while (activeDTCsLock.test_and_set(std::memory_order_acquire))
+  {
+  }
+  int16_t index = GetIndexOfDM1(DtcSpn(dtc_info_array[code]), DtcFmi(dtc_info_array[code]), activeDTCs, numActiveDTCs);
+  if (index >= 0)
+  {
+    numActiveDTCs--;
+    activeDTCs[index] = activeDTCs[numActiveDTCs];
+  }
+  activeDTCsLock.clear(std::memory_order_release);
+  return (index >= 0) ? 0 : -1;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// J1939-21 TRANSPORT PROTOCOL - TP.CM / TP.DT SEGMENTING AND REASSEMBLY
+// Messages of 9..1785 bytes are sent as BAM (broadcast, paced) or CMDT (RTS/CTS, peer to peer).
+// Sessions live in a fixed pool that is never freed to the heap, so hundreds of concurrent sessions
+// don't cause any allocation. TP.DT frames only carry source + destination, so sessions are indexed
+// by (src, dest) and the PGN being transported is kept inside the session. Only CMDT addressed to our own
+// address gets CTS / EOM ACK / abort replies, CMDT between other nodes is reassembled by listening only.
+//---------------------------------------------------------------------------------------------------------
+#define PGN_TP_CM 0xEC00u
+#define PGN_TP_DT 0xEB00u
+#define J1939_GLOBAL_ADDR 0xFF
+#define J1939_TP_PRIO 7
+
+#define TP_CM_RTS 16
+#define TP_CM_CTS 17
+#define TP_CM_EOM_ACK 19
+#define TP_CM_BAM 32
+#define TP_CM_ABORT 255
+
+#define TP_ABORT_BUSY 1          // already in a connection managed session
+#define TP_ABORT_RESOURCES 2     // out of sessions
+#define TP_ABORT_TIMEOUT 3
+#define TP_ABORT_CTS_IN_DATA 4   // CTS received while data transfer was in progress
+#define TP_ABORT_UNEXPECTED_DT 6
+#define TP_ABORT_BAD_SEQ 7
+#define TP_ABORT_BAD_SIZE 9
+
+#define TP_BYTES_PER_PACKET 7
+#define TP_MAX_PACKETS 255
+#define TP_MIN_PAYLOAD 9 // anything shorter fits in a single frame
+#define TP_MAX_PAYLOAD (TP_BYTES_PER_PACKET * TP_MAX_PACKETS) // 1785 bytes
+#define TP_PAD_BYTE 0xFF
+
+#define TP_TIMEOUT_T1 750   // rx: time between two TP.DT packets
+#define TP_TIMEOUT_T2 1250  // rx: time between sending CTS and receiving TP.DT
+#define TP_TIMEOUT_T3 1250  // tx: time between sending the last packet (or RTS) and receiving CTS/EOM ACK
+#define TP_TIMEOUT_T4 1050  // tx: time between a "hold" CTS (0 packets) and the next CTS
+#define TP_BAM_PACKET_GAP 50 // tx: BAM packets have to be 50..200 ms apart
+
+#ifndef TP_MAX_NUM_SESSIONS
+#define TP_MAX_NUM_SESSIONS 256
+#endif
+#define TP_CTS_WINDOW 16 // how many packets we let a CMDT sender send per CTS
+#define TP_NO_SESSION 0
+
+#define BITS_PER_BYTE 8
+#define CAN_MAX_DATA_LEN 8
+#define CANFD_MAX_DATA_LEN 64
+
+// CAN FD DLC codes 9..15 stand for 12, 16, 20, 24, 32, 48 and 64 bytes
+static const uint8_t canfd_dlc_to_len[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+
+uint8_t CanFdDlcToLen(uint8_t dlc)
+{
+  return canfd_dlc_to_len[dlc & MASK_4LSB];
+}
+
+// smallest DLC whose payload holds len bytes (len <= 64)
+uint8_t CanFdLenToDlc(uint8_t len)
+{
+  if (len <= CAN_MAX_DATA_LEN)
+    return len;
+  if (len <= 24)
+    return CAN_MAX_DATA_LEN + (len - CAN_MAX_DATA_LEN + 3) / 4; // 12..24 in steps of 4
+  return (len <= 32) ? 13 : (len <= 48) ? 14 : 15;
+}
+
+// len rounded up to the next length an FD frame can have, the rest gets padded
+uint8_t CanFdRoundLen(uint8_t len)
+{
+  return CanFdDlcToLen(CanFdLenToDlc(len));
+}
+
+typedef struct j1939_frame_t
+{
+  uint32_t pgn;
+  uint8_t prio;
+  uint8_t src;
+  uint8_t dest;
+  uint8_t dlc;  // payload bytes: 0..8, or one of the FD lengths on CAN FD
+  uint8_t data[CANFD_MAX_DATA_LEN];
+} j1939_frame_ts;
+
+typedef enum
+{
+  TP_STATE_FREE,
+  TP_STATE_RX_BAM,
+  TP_STATE_RX_CMDT,
+  TP_STATE_RX_DONE,  // reassembled, owned by the caller until TpReleaseSession(). Not in tpSessionIndex anymore
+  TP_STATE_TX_BAM,
+  TP_STATE_TX_WAIT_CTS,
+  TP_STATE_TX_DATA,
+  TP_STATE_TX_WAIT_EOMA,
+  TP_STATE_TX_DONE,     // finished, released by the next TpPollTransmit()
+  TP_STATE_TX_ABORTED,  // aborted by the receiver, released by the next TpPollTransmit()
+  NUM_TP_STATES
+} tp_state;
+
+typedef enum
+{
+  TP_TX_WAIT,    // nothing to send right now
+  TP_TX_FRAME,   // *frame has to be sent
+  TP_TX_DONE,    // transfer finished, session released
+  TP_TX_ABORTED  // transfer aborted or timed out, session released
+} tp_tx_status;
+
+typedef struct tp_session_t
+{
+  tp_state state;
+  uint32_t pgn;
+  uint8_t src;
+  uint8_t dest;
+  uint16_t size;
+  uint8_t numPackets;
+  uint16_t nextSeq;    // next packet we expect (rx) or send (tx), starts at 1. 16 bits so it can go past packet 255
+  uint16_t windowEnd;  // last packet number allowed by the current CTS
+  uint8_t maxPerCts;   // rx: limit the sender gave us in the RTS
+  bool passive;        // rx: CMDT between two other nodes, we only listen and never reply
+  uint64_t deadline;   // timeout (or for BAM tx: next send time) in millis()
+  uint8_t data[TP_MAX_PAYLOAD];
+} tp_session_ts;
+
+tp_session_ts tpSessions[TP_MAX_NUM_SESSIONS];
+uint16_t tpSessionIndex[2][256][256];  // [isTx][src][dest] -> slot + 1, TP_NO_SESSION if none. O(1) lookup for every TP.DT
+uint16_t tpFreeList[TP_MAX_NUM_SESSIONS];
+uint16_t tpNumFree = 0;
+bool tpPoolReady = false;
+
+void TpInit(void)
+{
+  int i;
+  for (i = 0; i < TP_MAX_NUM_SESSIONS; i++)
+  {
+    tpSessions[i].state = TP_STATE_FREE;
+    tpFreeList[i] = TP_MAX_NUM_SESSIONS - 1 - i; // hand out slot 0 first
+  }
+  tpNumFree = TP_MAX_NUM_SESSIONS;
+  memset(tpSessionIndex, 0, sizeof(tpSessionIndex));
+  tpPoolReady = true;
+}
+
+bool TpIsTxState(tp_state state)
+{
+  return state >= TP_STATE_TX_BAM;
+}
+
+tp_session_ts* TpFindSession(uint8_t src, uint8_t dest, bool isTx)
+{
+  uint16_t slot = tpSessionIndex[isTx][src][dest];
+  return (slot == TP_NO_SESSION) ? NULL : &tpSessions[slot - 1];
+}
+
+tp_session_ts* TpAllocSession(uint8_t src, uint8_t dest, uint32_t pgn, uint16_t size, tp_state state)
+{
+  if (!tpPoolReady)
+    TpInit();
+  if (tpNumFree == 0)
+    return NULL;
+  uint16_t slot = tpFreeList[--tpNumFree];
+  tp_session_ts* session = &tpSessions[slot];
+  session->state = state;
+  session->pgn = pgn;
+  session->src = src;
+  session->dest = dest;
+  session->size = size;
+  session->numPackets = (uint8_t)((size + TP_BYTES_PER_PACKET - 1) / TP_BYTES_PER_PACKET);
+  session->nextSeq = 1;
+  session->windowEnd = 0;
+  session->maxPerCts = 0xFF;
+  session->passive = false;
+  session->deadline = 0;
+  tpSessionIndex[TpIsTxState(state)][src][dest] = slot + 1;
+  return session;
+}
+
+void TpReleaseSession(tp_session_ts* session)
+{
+  if (session == NULL || session->state == TP_STATE_FREE)
+    return;
+  uint16_t slot = (uint16_t)(session - tpSessions);
+  bool isTx = TpIsTxState(session->state);
+  if (tpSessionIndex[isTx][session->src][session->dest] == slot + 1)
+    tpSessionIndex[isTx][session->src][session->dest] = TP_NO_SESSION;
+  session->state = TP_STATE_FREE;
+  tpFreeList[tpNumFree++] = slot;
+}
+
+uint16_t TpNumActiveSessions(void)
+{
+  return tpPoolReady ? (TP_MAX_NUM_SESSIONS - tpNumFree) : 0;
+}
+
+void TpBuildCmFrame(j1939_frame_ts* frame, uint8_t src, uint8_t dest, uint8_t control, uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4, uint32_t pgn)
+{
+  frame->pgn = PGN_TP_CM;
+  frame->prio = J1939_TP_PRIO;
+  frame->src = src;
+  frame->dest = dest;
+  frame->dlc = 8;
+  frame->data[0] = control;
+  frame->data[1] = b1;
+  frame->data[2] = b2;
+  frame->data[3] = b3;
+  frame->data[4] = b4;
+  frame->data[5] = pgn & MASK_8LSB;
+  frame->data[6] = (pgn >> SHIFT_8b) & MASK_8LSB;
+  frame->data[7] = (pgn >> (2 * SHIFT_8b)) & MASK_8LSB;
+}
+
+void TpBuildAbortFrame(j1939_frame_ts* frame, uint8_t src, uint8_t dest, uint8_t reason, uint32_t pgn)
+{
+  TpBuildCmFrame(frame, src, dest, TP_CM_ABORT, reason, TP_PAD_BYTE, TP_PAD_BYTE, TP_PAD_BYTE, pgn);
+}
+
+// rx side: ask the sender for the next window of packets
+void TpBuildCtsFrame(tp_session_ts* session, j1939_frame_ts* frame, uint64_t current_time)
+{
+  uint8_t remaining = session->numPackets - session->nextSeq + 1;
+  uint8_t window = (remaining < TP_CTS_WINDOW) ? remaining : TP_CTS_WINDOW;
+  if (window > session->maxPerCts)
+    window = session->maxPerCts;
+  session->windowEnd = session->nextSeq + window - 1;
+  session->deadline = current_time + TP_TIMEOUT_T2;
+  TpBuildCmFrame(frame, session->dest, session->src, TP_CM_CTS, window, session->nextSeq, TP_PAD_BYTE, TP_PAD_BYTE, session->pgn);
+}
+
+typedef struct tp_rx_result_t
+{
+  bool hasReply;
+  j1939_frame_ts reply;       // TP.CM frame the caller has to send (CTS, EOM ACK or abort)
+  tp_session_ts* completed;   // reassembled message, valid until TpReleaseSession() is called on it
+} tp_rx_result_ts;
+
+int TpReceiveCm(const j1939_frame_ts* frame, uint8_t localAddr, uint64_t current_time, tp_rx_result_ts* result)
+{
+  uint8_t control = frame->data[0];
+  uint16_t size = frame->data[1] | (frame->data[2] << SHIFT_8b);
+  uint32_t pgn = frame->data[5] | (frame->data[6] << SHIFT_8b) | ((uint32_t)frame->data[7] << (2 * SHIFT_8b));
+  tp_session_ts* session;
+
+  switch (control)
+  {
+  case TP_CM_BAM:
+  case TP_CM_RTS:
+  {
+    bool replies = control == TP_CM_RTS && frame->dest == localAddr; // BAM and foreign CMDT never get an answer
+    session = TpFindSession(frame->src, frame->dest, false);
+    if (session != NULL && replies && session->state == TP_STATE_RX_CMDT)
+    {
+      result->hasReply = true; // the sender already has a transfer running with us, that one goes on
+      TpBuildAbortFrame(&result->reply, frame->dest, frame->src, TP_ABORT_BUSY, pgn);
+      return -1;
+    }
+    if (session != NULL) // otherwise a new announcement replaces whatever was going on between these two
+      TpReleaseSession(session);
+    bool validSize = size >= TP_MIN_PAYLOAD && size <= TP_MAX_PAYLOAD
+      && frame->data[3] == (size + TP_BYTES_PER_PACKET - 1) / TP_BYTES_PER_PACKET;
+    if (!validSize || (session = TpAllocSession(frame->src, frame->dest, pgn, size, (control == TP_CM_BAM) ? TP_STATE_RX_BAM : TP_STATE_RX_CMDT)) == NULL)
+    {
+      if (replies)
+      {
+        result->hasReply = true;
+        TpBuildAbortFrame(&result->reply, frame->dest, frame->src, validSize ? TP_ABORT_RESOURCES : TP_ABORT_BAD_SIZE, pgn);
+      }
+      return -1;
+    }
+    if (control == TP_CM_BAM)
+    {
+      session->deadline = current_time + TP_TIMEOUT_T1;
+      return 0;
+    }
+    if (!replies) // the receiver's CTS decides when packets come, wait for it as long as it may take
+    {
+      session->passive = true;
+      session->deadline = current_time + TP_TIMEOUT_T2;
+      return 0;
+    }
+    session->maxPerCts = (frame->data[4] == 0) ? 0xFF : frame->data[4];
+    result->hasReply = true;
+    TpBuildCtsFrame(session, &result->reply, current_time);
+    return 0;
+  }
+  case TP_CM_CTS: // we are the sender: frame->dest is us
+    session = TpFindSession(frame->dest, frame->src, true);
+    if (session == NULL)
+    {
+      session = TpFindSession(frame->dest, frame->src, false);
+      if (session != NULL && session->passive) // a foreign receiver asked for more, its packets are coming
+        session->deadline = current_time + TP_TIMEOUT_T2;
+      return 0;
+    }
+    if (session->state == TP_STATE_TX_DATA)
+    {
+      result->hasReply = true;
+      TpBuildAbortFrame(&result->reply, session->src, session->dest, TP_ABORT_CTS_IN_DATA, session->pgn);
+      TpReleaseSession(session);
+      return -1;
+    }
+    if (session->state != TP_STATE_TX_WAIT_CTS && session->state != TP_STATE_TX_WAIT_EOMA)
+      return 0;
+    if (frame->data[1] == 0) // hold the connection open
+    {
+      session->state = TP_STATE_TX_WAIT_CTS;
+      session->deadline = current_time + TP_TIMEOUT_T4;
+      return 0;
+    }
+    if (frame->data[2] == 0 || frame->data[2] > session->numPackets)
+    {
+      result->hasReply = true;
+      TpBuildAbortFrame(&result->reply, session->src, session->dest, TP_ABORT_BAD_SEQ, session->pgn);
+      TpReleaseSession(session);
+      return -1;
+    }
+    session->nextSeq = frame->data[2];
+    session->windowEnd = session->nextSeq + frame->data[1] - 1;
+    if (session->windowEnd > session->numPackets || session->windowEnd < session->nextSeq)
+      session->windowEnd = session->numPackets;
+    session->state = TP_STATE_TX_DATA;
+    return 0;
+  case TP_CM_EOM_ACK:
+    session = TpFindSession(frame->dest, frame->src, true);
+    if (session != NULL && session->state == TP_STATE_TX_WAIT_EOMA)
+      session->state = TP_STATE_TX_DONE;
+    return 0;
+  case TP_CM_ABORT: // can come from either side
+    session = TpFindSession(frame->dest, frame->src, true);
+    if (session == NULL)
+      session = TpFindSession(frame->src, frame->dest, false);
+    if (session == NULL) // a foreign receiver gave up on a transfer we listen to
+    {
+      session = TpFindSession(frame->dest, frame->src, false);
+      if (session != NULL && !session->passive)
+        session = NULL;
+    }
+    if (session == NULL || session->state == TP_STATE_TX_DONE)
+      return 0;
+    if (TpIsTxState(session->state))
+      session->state = TP_STATE_TX_ABORTED; // the owner still holds the pointer, let TpPollTransmit() release it
+    else
+      TpReleaseSession(session);
+    return 0;
+  default:
+    return 0;
+  }
+}
+
+int TpReceiveDt(const j1939_frame_ts* frame, uint64_t current_time, tp_rx_result_ts* result)
+{
+  tp_session_ts* session = TpFindSession(frame->src, frame->dest, false);
+  if (session == NULL || (session->state != TP_STATE_RX_BAM && session->state != TP_STATE_RX_CMDT))
+    return 0; // not for us, or left over after an abort
+  bool isCmdt = session->state == TP_STATE_RX_CMDT;
+  uint8_t seq = frame->data[0];
+
+  bool replies = isCmdt && !session->passive;
+
+  if (seq < session->nextSeq) // duplicate, sender is repeating itself
+    return 0;
+  if (seq != session->nextSeq || (replies && seq > session->windowEnd))
+  {
+    if (replies)
+    {
+      result->hasReply = true;
+      TpBuildAbortFrame(&result->reply, session->dest, session->src, (seq == session->nextSeq) ? TP_ABORT_UNEXPECTED_DT : TP_ABORT_BAD_SEQ, session->pgn);
+    }
+    TpReleaseSession(session);
+    return -1;
+  }
+
+  uint16_t pos = (uint16_t)(seq - 1) * TP_BYTES_PER_PACKET;
+  uint16_t len = session->size - pos;
+  if (len > TP_BYTES_PER_PACKET)
+    len = TP_BYTES_PER_PACKET;
+  memcpy(&session->data[pos], &frame->data[1], len);
+  session->nextSeq++;
+  session->deadline = current_time + TP_TIMEOUT_T1;
+
+  if (seq == session->numPackets)
+  {
+    // hand it to the caller and take it out of the index: a new BAM/RTS between the same two nodes
+    // gets a fresh session instead of releasing this one under the caller's feet
+    tpSessionIndex[false][session->src][session->dest] = TP_NO_SESSION;
+    session->state = TP_STATE_RX_DONE;
+    result->completed = session;
+    if (replies)
+    {
+      result->hasReply = true;
+      TpBuildCmFrame(&result->reply, session->dest, session->src, TP_CM_EOM_ACK, session->size & MASK_8LSB, session->size >> SHIFT_8b, session->numPackets, TP_PAD_BYTE, session->pgn);
+    }
+  }
+  else if (replies && seq == session->windowEnd)
+  {
+    result->hasReply = true;
+    TpBuildCtsFrame(session, &result->reply, current_time);
+  }
+  return 0;
+}
+
+/**
+ * @brief Feeds one received TP.CM / TP.DT frame into the reassembler. Frames with other PGNs are ignored.
+ *
+ * @param frame received frame
+ * @param localAddr our own source address. Only CMDT sent to it gets CTS / EOM ACK / abort replies,
+ *			CMDT to other nodes is reassembled silently. `J1939_GLOBAL_ADDR` listens to everything
+ * @param current_time millis() (or a fake time) used for the session timeouts
+ * @param *result reply frame to send and/or the completed message. Completed sessions stay allocated
+ *			until the caller is done with `result->completed->data` and calls `TpReleaseSession()`
+ * @return 0 if the frame was consumed or ignored, -1 if it made us drop a session or refuse a transfer
+ */
+int TpReceiveFrame(const j1939_frame_ts* frame, uint8_t localAddr, uint64_t current_time, tp_rx_result_ts* result)
+{
+  result->hasReply = false;
+  result->completed = NULL;
+  if (!tpPoolReady)
+    TpInit();
+  if (frame->dlc < 8)
+    return 0;
+  if (frame->pgn == PGN_TP_CM)
+    return TpReceiveCm(frame, localAddr, current_time, result);
+  if (frame->pgn == PGN_TP_DT)
+    return TpReceiveDt(frame, current_time, result);
+  return 0;
+}
+
+/**
+ * @brief Reserves a transmit session for `size` bytes without filling it. The caller writes the payload
+ *			straight into `session->data` (no intermediate buffer), then polls it with `TpPollTransmit()`.
+ *			`dest == J1939_GLOBAL_ADDR` sends it as BAM, anything else as CMDT.
+ *
+ * @return the session, or NULL if the size is invalid, the pool is empty or (src, dest) is already busy
+ */
+tp_session_ts* TpAllocTransmit(uint32_t pgn, uint8_t src, uint8_t dest, uint16_t size)
+{
+  if (size < TP_MIN_PAYLOAD || size > TP_MAX_PAYLOAD || TpFindSession(src, dest, true) != NULL)
+    return NULL;
+  tp_session_ts* session = TpAllocSession(src, dest, pgn, size, (dest == J1939_GLOBAL_ADDR) ? TP_STATE_TX_BAM : TP_STATE_TX_WAIT_CTS);
+  if (session == NULL)
+    return NULL;
+  session->nextSeq = 0; // 0 = announcement (BAM / RTS) not sent yet
+  return session;
+}
+
+/**
+ * @brief Starts sending `payload` with the transport protocol. The payload is copied into the session,
+ *			so the caller's buffer can be reused. Afterwards call `TpPollTransmit()` until it returns
+ *			`TP_TX_DONE` or `TP_TX_ABORTED`.
+ *
+ * @return the session, or NULL if the size is invalid, the pool is empty or (src, dest) is already busy
+ */
+tp_session_ts* TpStartTransmit(uint32_t pgn, uint8_t src, uint8_t dest, const uint8_t* payload, uint16_t size)
+{
+  tp_session_ts* session = TpAllocTransmit(pgn, src, dest, size);
+  if (session != NULL)
+    memcpy(session->data, payload, size);
+  return session;
+}
+
+/**
+ * @brief Gets the next frame of a transmit session. BAM packets are paced `TP_BAM_PACKET_GAP` apart,
+ *			CMDT packets are sent as fast as they are polled, within the window the receiver gave us.
+ *
+ * @return `TP_TX_FRAME` if *frame has to be sent. After `TP_TX_DONE` / `TP_TX_ABORTED` the session is released.
+ */
+tp_tx_status TpPollTransmit(tp_session_ts* session, uint64_t current_time, j1939_frame_ts* frame)
+{
+  if (session->nextSeq == 0) // announce
+  {
+    bool isBam = session->state == TP_STATE_TX_BAM;
+    TpBuildCmFrame(frame, session->src, session->dest, isBam ? TP_CM_BAM : TP_CM_RTS, session->size & MASK_8LSB, session->size >> SHIFT_8b,
+      session->numPackets, isBam ? TP_PAD_BYTE : TP_CTS_WINDOW, session->pgn);
+    session->nextSeq = 1;
+    session->deadline = current_time + (isBam ? TP_BAM_PACKET_GAP : TP_TIMEOUT_T3);
+    return TP_TX_FRAME;
+  }
+
+  switch (session->state)
+  {
+  case TP_STATE_TX_BAM:
+    if (session->nextSeq > session->numPackets)
+    {
+      TpReleaseSession(session);
+      return TP_TX_DONE;
+    }
+    if (current_time < session->deadline)
+      return TP_TX_WAIT;
+    break;
+  case TP_STATE_TX_DATA:
+    break;
+  case TP_STATE_TX_WAIT_CTS:
+  case TP_STATE_TX_WAIT_EOMA:
+    if (current_time < session->deadline)
+      return TP_TX_WAIT;
+    TpBuildAbortFrame(frame, session->src, session->dest, TP_ABORT_TIMEOUT, session->pgn);
+    TpReleaseSession(session);
+    return TP_TX_ABORTED; // frame still holds the abort, caller may send it
+  case TP_STATE_TX_DONE:
+    TpReleaseSession(session);
+    return TP_TX_DONE;
+  default: // aborted by the receiver
+    TpReleaseSession(session);
+    return TP_TX_ABORTED;
+  }
+
+  uint8_t seq = session->nextSeq;
+  uint16_t pos = (uint16_t)(seq - 1) * TP_BYTES_PER_PACKET;
+  uint16_t len = session->size - pos;
+  if (len > TP_BYTES_PER_PACKET)
+    len = TP_BYTES_PER_PACKET;
+  frame->pgn = PGN_TP_DT;
+  frame->prio = J1939_TP_PRIO;
+  frame->src = session->src;
+  frame->dest = session->dest;
+  frame->dlc = 8;
+  frame->data[0] = seq;
+  memcpy(&frame->data[1], &session->data[pos], len);
+  memset(&frame->data[1 + len], TP_PAD_BYTE, TP_BYTES_PER_PACKET - len);
+  session->nextSeq++;
+
+  if (session->state == TP_STATE_TX_BAM)
+  {
+    session->deadline = current_time + TP_BAM_PACKET_GAP;
+  }
+  else if (seq == session->numPackets)
+  {
+    session->state = TP_STATE_TX_WAIT_EOMA;
+    session->deadline = current_time + TP_TIMEOUT_T3;
+  }
+  else if (seq == session->windowEnd)
+  {
+    session->state = TP_STATE_TX_WAIT_CTS;
+    session->deadline = current_time + TP_TIMEOUT_T3;
+  }
+  return TP_TX_FRAME;
+}
+
+/**
+ * @brief Drops every receive session whose timer ran out. CMDT sessions addressed to us get an abort frame
+ *			(`TP_ABORT_TIMEOUT`) written to `aborts[]` so the other side knows. Transmit sessions time out
+ *			inside `TpPollTransmit()`.
+ *
+ * @return number of sessions that were dropped
+ */
+uint16_t TpCheckTimeouts(uint64_t current_time, j1939_frame_ts aborts[], uint16_t maxAborts, uint16_t* numAborts)
+{
+  uint16_t dropped = 0;
+  *numAborts = 0;
+  if (!tpPoolReady)
+    return 0;
+  int i;
+  for (i = 0; i < TP_MAX_NUM_SESSIONS; i++)
+  {
+    tp_session_ts* session = &tpSessions[i];
+    if ((session->state != TP_STATE_RX_BAM && session->state != TP_STATE_RX_CMDT) || current_time < session->deadline)
+      continue;
+    if (session->state == TP_STATE_RX_CMDT && !session->passive && *numAborts < maxAborts)
+    {
+      TpBuildAbortFrame(&aborts[*numAborts], session->dest, session->src, TP_ABORT_TIMEOUT, session->pgn);
+      *numAborts += 1;
+    }
+    TpReleaseSession(session);
+    dropped++;
+  }
+  return dropped;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// J1939-73 DM1 / DM2 - STANDARD WIRE FORMAT
+// Unlike SerializeDTCMessages() (10-bit dtc_info_array indices), this is what off-board tools read:
+//   byte 0: lamp status  MIL(8-7) RSL(6-5) AWL(4-3) PL(2-1)
+//   byte 1: lamp flash   same layout, 00 = slow, 01 = fast, 11 = not flashing
+//   then 4 bytes per DTC: SPN bits 0-7, SPN bits 8-15, SPN bits 16-18 (8-6) + FMI (5-1), CM (8) + OC (7-1)
+// More than one DTC doesn't fit in 8 bytes and goes out through the transport protocol.
+//---------------------------------------------------------------------------------------------------------
+#define PGN_DM1 0xFECAu // active DTCs
+#define PGN_DM2 0xFECBu // previously active DTCs
+#define J1939_DM_PRIO 6
+
+#define DM_HEADER_BYTES 2
+#define DM_BYTES_PER_DTC 4
+#define DM_MAX_DTCS ((TP_MAX_PAYLOAD - DM_HEADER_BYTES) / DM_BYTES_PER_DTC) // 445 DTCs in one TP message
+
+#define SHIFT_DM_LAMP_MIL 6
+#define SHIFT_DM_LAMP_RSL 4
+#define SHIFT_DM_LAMP_AWL 2
+#define SHIFT_DM_LAMP_PL 0
+#define DM_LAMP_OFF 0x00
+#define DM_LAMP_ON 0x01
+#define DM_FLASH_NONE 0xFF
+
+#define SHIFT_DM_SPN_HI 21
+#define SHIFT_DM_FMI 16
+#define SHIFT_DM_OC 24
+#define MASK_DM_SPN_LO 0xFFFF
+#define MASK_DM_SPN_HI 0x70000
+#define MASK_DM_UNMOVED 0xFF00FFFF // SPN low 16 bits + OC + CM sit in the same place on the wire and in rbr_isobus_dtc_ts
+#define MASK_5LSB 0x1F
+#define MASK_7LSB 0x7F
+
+// the compact lamps nibble used by SerializeDTCMessages(): bit 3 = MIL, 2 = RSL, 1 = AWL, 0 = PL
+#define COMPACT_LAMP_MIL 0x08
+#define COMPACT_LAMP_RSL 0x04
+#define COMPACT_LAMP_AWL 0x02
+#define COMPACT_LAMP_PL 0x01
+
+typedef struct dm_lamps_t
+{
+  uint8_t status;
+  uint8_t flash;
+} dm_lamps_ts;
+
+dm_lamps_ts DmLampsFromCompact(uint8_t lamps)
+{
+  dm_lamps_ts out;
+  out.status = (((lamps & COMPACT_LAMP_MIL) ? DM_LAMP_ON : DM_LAMP_OFF) << SHIFT_DM_LAMP_MIL)
+    | (((lamps & COMPACT_LAMP_RSL) ? DM_LAMP_ON : DM_LAMP_OFF) << SHIFT_DM_LAMP_RSL)
+    | (((lamps & COMPACT_LAMP_AWL) ? DM_LAMP_ON : DM_LAMP_OFF) << SHIFT_DM_LAMP_AWL)
+    | (((lamps & COMPACT_LAMP_PL) ? DM_LAMP_ON : DM_LAMP_OFF) << SHIFT_DM_LAMP_PL);
+  out.flash = DM_FLASH_NONE;
+  return out;
+}
+
+uint8_t DmLampsToCompact(dm_lamps_ts lamps)
+{
+  return ((((lamps.status >> SHIFT_DM_LAMP_MIL) & MASK_2LSB) == DM_LAMP_ON) ? COMPACT_LAMP_MIL : 0)
+    | ((((lamps.status >> SHIFT_DM_LAMP_RSL) & MASK_2LSB) == DM_LAMP_ON) ? COMPACT_LAMP_RSL : 0)
+    | ((((lamps.status >> SHIFT_DM_LAMP_AWL) & MASK_2LSB) == DM_LAMP_ON) ? COMPACT_LAMP_AWL : 0)
+    | ((((lamps.status >> SHIFT_DM_LAMP_PL) & MASK_2LSB) == DM_LAMP_ON) ? COMPACT_LAMP_PL : 0);
+}
+
+// rbr_isobus_dtc_ts <-> the 32-bit little endian DTC record of DM1/DM2. Only bits 16-23 move: the wire has
+// FMI below the SPN's top 3 bits, the packed form has it above
+uint32_t DmWordFromDtc(rbr_isobus_dtc_ts dtc)
+{
+  return (dtc.word & MASK_DM_UNMOVED)
+    | ((dtc.word & MASK_DM_SPN_HI) << (SHIFT_DM_SPN_HI - 16))
+    | (((dtc.word >> SHIFT_DTC_FMI) & MASK_5LSB) << SHIFT_DM_FMI);
+}
+
+rbr_isobus_dtc_ts DtcFromDmWord(uint32_t word)
+{
+  return { (word & MASK_DM_UNMOVED)
+    | ((word >> (SHIFT_DM_SPN_HI - 16)) & MASK_DM_SPN_HI)
+    | (((word >> SHIFT_DM_FMI) & MASK_5LSB) << SHIFT_DTC_FMI) };
+}
+
+// Size of the DM1/DM2 payload for numDTCs. Single frames are always padded to 8 bytes.
+uint16_t DmEncodedSize(uint16_t numDTCs)
+{
+  uint16_t size = DM_HEADER_BYTES + DM_BYTES_PER_DTC * ((numDTCs == 0) ? 1 : numDTCs);
+  return (size < MAX_NUM_BYTES_PER_DTC_MSG) ? MAX_NUM_BYTES_PER_DTC_MSG : size;
+}
+
+/**
+ * @brief Writes a DM1/DM2 payload straight from a DTC list into `out`. With no DTCs the
+ *			"no active DTC" record (SPN 0, FMI 0, OC 0) is sent, as J1939-73 asks for.
+ *
+ * @param lamps lamp status/flash bytes
+ * @param listDTCs DTCs to send
+ * @param numDTCs number of entries in listDTCs
+ * @param out destination, at least `DmEncodedSize(numDTCs)` bytes
+ * @param maxLen size of out
+ * @return number of bytes written, 0 if out is too small or numDTCs > DM_MAX_DTCS
+ */
+uint16_t DmEncode(dm_lamps_ts lamps, const rbr_isobus_dtc_ts listDTCs[], uint16_t numDTCs, uint8_t* out, uint16_t maxLen)
+{
+  uint16_t size = DmEncodedSize(numDTCs);
+  if (numDTCs > DM_MAX_DTCS || size > maxLen)
+    return 0;
+  out[0] = lamps.status;
+  out[1] = lamps.flash;
+  if (numDTCs == 0)
+    memset(&out[DM_HEADER_BYTES], 0, DM_BYTES_PER_DTC);
+  int i;
+  for (i = 0; i < numDTCs; i++)
+  {
+    uint32_t word = DmWordFromDtc(listDTCs[i]); // CM bit as stored, 0 for dtc_info_array entries (J1939-73 version 4 SPN layout)
+    uint8_t* dst = &out[DM_HEADER_BYTES + DM_BYTES_PER_DTC * i];
+    dst[0] = word & MASK_8LSB;
+    dst[1] = (word >> SHIFT_8b) & MASK_8LSB;
+    dst[2] = (word >> (2 * SHIFT_8b)) & MASK_8LSB;
+    dst[3] = (word >> (3 * SHIFT_8b)) & MASK_8LSB;
+  }
+  uint16_t used = DM_HEADER_BYTES + DM_BYTES_PER_DTC * ((numDTCs == 0) ? 1 : numDTCs);
+  memset(&out[used], TP_PAD_BYTE, size - used);
+  return size;
+}
+
+/**
+ * @brief Encodes a DM1/DM2 and gets it ready to send. Lists that fit in one frame are written to *frame,
+ *			longer ones are encoded straight into a BAM session's buffer, which the caller then drains with
+ *			`TpPollTransmit()`. On CAN FD a frame holds up to 15 DTCs, padded to the next FD length.
+ *
+ * @param pgn PGN_DM1 or PGN_DM2
+ * @param maxFrameLen CAN_MAX_DATA_LEN for classic CAN, CANFD_MAX_DATA_LEN for CAN FD
+ * @return 1 if *frame is ready, 2 if *session was started, -1 if the list is too long or the TP pool is full
+ */
+int DmPrepareTransmit(uint32_t pgn, uint8_t src, dm_lamps_ts lamps, const rbr_isobus_dtc_ts listDTCs[], uint16_t numDTCs, uint8_t maxFrameLen, j1939_frame_ts* frame, tp_session_ts** session)
+{
+  uint16_t size = DmEncodedSize(numDTCs);
+  *session = NULL;
+  if (size <= maxFrameLen && size <= CANFD_MAX_DATA_LEN)
+  {
+    frame->pgn = pgn;
+    frame->prio = J1939_DM_PRIO;
+    frame->src = src;
+    frame->dest = J1939_GLOBAL_ADDR;
+    frame->dlc = CanFdRoundLen((uint8_t)size);
+    DmEncode(lamps, listDTCs, numDTCs, frame->data, CANFD_MAX_DATA_LEN);
+    memset(&frame->data[size], TP_PAD_BYTE, frame->dlc - size);
+    return 1;
+  }
+  if (numDTCs > DM_MAX_DTCS || (*session = TpAllocTransmit(pgn, src, J1939_GLOBAL_ADDR, size)) == NULL)
+    return -1;
+  DmEncode(lamps, listDTCs, numDTCs, (*session)->data, TP_MAX_PAYLOAD);
+  return 2;
+}
+
+// SerializeDTCMessages() for CAN FD: lamps (byte 0), count (byte 1) and the 10-bit dtc_info_array indices
+// packed LSB first from byte 2 on, so the full list of 20 fits in one 32-byte frame instead of four.
+#define DTC_FD_HEADER_BYTES 2
+#define DTC_FD_INDEX_BITS 10
+
+/**
+ * @brief Packs a DTC list into one CAN FD payload.
+ *
+ * @param out at least CANFD_MAX_DATA_LEN bytes
+ * @return payload length (an FD length, padded with 0xFF), 0 if numDTCs is more than RBR_ISOBUS_DTC_LIST_SIZE_DU16
+ */
+uint8_t SerializeDTCMessagesFd(uint8_t lamps, const rbr_isobus_dtc_ts listDTCs[], uint8_t numDTCs, uint8_t out[CANFD_MAX_DATA_LEN])
+{
+  if (numDTCs > RBR_ISOBUS_DTC_LIST_SIZE_DU16)
+    return 0;
+  uint8_t used = DTC_FD_HEADER_BYTES + (DTC_FD_INDEX_BITS * numDTCs + BITS_PER_BYTE - 1) / BITS_PER_BYTE;
+  uint8_t len = CanFdRoundLen(used);
+  memset(out, 0, used);
+  memset(&out[used], TP_PAD_BYTE, len - used);
+  out[0] = lamps & MASK_4LSB;
+  out[1] = numDTCs;
+  int i;
+  for (i = 0; i < numDTCs; i++)
+  {
+    uint32_t pos = BITS_PER_BYTE * DTC_FD_HEADER_BYTES + DTC_FD_INDEX_BITS * i;
+    uint32_t bits = ((uint16_t)DtcIndexLookup(DtcSpn(listDTCs[i]), DtcFmi(listDTCs[i])) & MASK_10LSB) << (pos % BITS_PER_BYTE);
+    out[pos / BITS_PER_BYTE] |= bits & MASK_8LSB;
+    out[pos / BITS_PER_BYTE + 1] |= (bits >> SHIFT_8b) & MASK_8LSB; // indices start at bit 0, 2, 4 or 6, never reaching a third byte
+  }
+  return len;
+}
+
+// Returns 0, or -1 if the payload is shorter than its count says. Unknown DTCs (index 0x3FF) are dropped.
+int ParseDTCMessagesFd(uint8_t* lamps, const uint8_t payload[], uint8_t len, rbr_isobus_dtc_ts listDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16], uint8_t* numDTCs)
+{
+  if (len < DTC_FD_HEADER_BYTES || payload[1] > RBR_ISOBUS_DTC_LIST_SIZE_DU16
+    || len < DTC_FD_HEADER_BYTES + (DTC_FD_INDEX_BITS * payload[1] + BITS_PER_BYTE - 1) / BITS_PER_BYTE)
+    return -1;
+  *lamps = payload[0] & MASK_4LSB;
+  *numDTCs = 0;
+  int i;
+  for (i = 0; i < payload[1]; i++)
+  {
+    uint32_t pos = BITS_PER_BYTE * DTC_FD_HEADER_BYTES + DTC_FD_INDEX_BITS * i;
+    uint32_t bits = payload[pos / BITS_PER_BYTE] | (payload[pos / BITS_PER_BYTE + 1] << SHIFT_8b);
+    uint16_t index = (bits >> (pos % BITS_PER_BYTE)) & MASK_10LSB;
+    if (index < NUM_DTC_CODES)
+      listDTCs[(*numDTCs)++] = dtc_info_array[index];
+  }
+  return 0;
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DM_DECODE_SSE2 1
+// the SSE2 path converts 4 wire records into 4 packed DTCs in place, one 128-bit load and store
+static_assert(sizeof(rbr_isobus_dtc_ts) == DM_BYTES_PER_DTC, "rbr_isobus_dtc_ts layout changed, fix DmDecode()");
+#endif
+
+/**
+ * @brief Decodes a DM1/DM2 payload (a single frame, or `completed->data` from the TP reassembler) into a DTC
+ *			list. 4 DTCs are converted per SSE2 step where available. The "no active DTC" record decodes to 0 DTCs.
+ *
+ * @param payload DM1/DM2 bytes
+ * @param len number of bytes in payload
+ * @param *lamps lamp status/flash bytes
+ * @param listDTCs output
+ * @param maxDTCs size of listDTCs
+ * @param *numDTCs how many DTCs were written
+ * @return 0 on success, -1 if the payload is too short or listDTCs was too small (filled up to maxDTCs)
+ */
+int DmDecode(const uint8_t* payload, uint16_t len, dm_lamps_ts* lamps, rbr_isobus_dtc_ts listDTCs[], uint16_t maxDTCs, uint16_t* numDTCs)
+{
+  *numDTCs = 0;
+  if (len < DM_HEADER_BYTES + DM_BYTES_PER_DTC)
+    return -1;
+  lamps->status = payload[0];
+  lamps->flash = payload[1];
+
+  uint16_t count = (len - DM_HEADER_BYTES) / DM_BYTES_PER_DTC;
+  const uint8_t* src = &payload[DM_HEADER_BYTES];
+  if (count == 1 && src[0] == 0 && src[1] == 0 && src[2] == 0) // SPN 0 / FMI 0 = no DTC
+    return 0;
+  while (count > 0) // single frames are padded with 0xFF, never treat that as a DTC
+  {
+    const uint8_t* last = &src[DM_BYTES_PER_DTC * (count - 1)];
+    if ((last[0] & last[1] & last[2] & last[3]) != TP_PAD_BYTE)
+      break;
+    count--;
+  }
+  int ret = 0;
+  if (count > maxDTCs)
+  {
+    count = maxDTCs;
+    ret = -1;
+  }
+
+  int i = 0;
+#ifdef DM_DECODE_SSE2
+  const __m128i maskUnmoved = _mm_set1_epi32((int)MASK_DM_UNMOVED);
+  const __m128i maskSpnHi = _mm_set1_epi32(MASK_DM_SPN_HI);
+  const __m128i maskFmi = _mm_set1_epi32(MASK_5LSB << SHIFT_DTC_FMI);
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128i words = _mm_loadu_si128((const __m128i*)&src[DM_BYTES_PER_DTC * i]);
+    __m128i spnHi = _mm_and_si128(_mm_srli_epi32(words, SHIFT_DM_SPN_HI - 16), maskSpnHi);
+    __m128i fmi = _mm_and_si128(_mm_slli_epi32(words, SHIFT_DTC_FMI - SHIFT_DM_FMI), maskFmi);
+    _mm_storeu_si128((__m128i*)&listDTCs[i], _mm_or_si128(_mm_and_si128(words, maskUnmoved), _mm_or_si128(spnHi, fmi)));
+  }
+#endif
+  for (; i < count; i++)
+  {
+    const uint8_t* dtc = &src[DM_BYTES_PER_DTC * i];
+    uint32_t word = dtc[0] | (dtc[1] << SHIFT_8b) | (dtc[2] << (2 * SHIFT_8b)) | ((uint32_t)dtc[3] << (3 * SHIFT_8b));
+    listDTCs[i] = DtcFromDmWord(word);
+  }
+  *numDTCs = count;
+  return ret;
+}
+
+
+//void SetMRFRMRelay(int byte, int bit, int spnInfoIndex, int state)
+//{
+//#define BITS_PER_BYTE 8
+//  uint8_t data[8] = { 0xFF,0xAA,0,0,0,0,0,0 };
+//#define MASK_2LSB 0x03
+//  uint8_t byteIndex = byte - 1; // These values start from 1, not 0
+//  uint8_t bitIndex = bit - 1;
+//  uint8_t mask = MASK_2LSB;
+//
+//  printf("mask1: %02X\n", mask);
+//  uint8_t shift = (BITS_PER_BYTE - bit) - 1;
+//  mask = mask << shift;
+//
+//  printf("mask2: %02X\n", mask);
+//  mask = ~mask;
+//
+//  printf("mask3: %02X\n", mask);
+//
+//  uint8_t originalVal = data[byteIndex];
+//
+//  uint8_t oldValue = data[byteIndex] & mask; // remove what we are changing from the current state
+//  uint8_t newValue = state << shift; // shift the 2-bit state into position
+//  data[byteIndex] = oldValue | newValue; // OR the new state with the masked oldValue
+//
+//  printf("byteIndex: %02X\n", byteIndex);
+//  printf("bitIndex: %02X\n", bitIndex);
+//  printf("mask: %02X\n", mask);
+//  printf("shift: %d\n", shift);
+//  printf("original val: %02X\n", originalVal);
+//  printf("masked old val: %02X\n", oldValue);
+//  printf("masked new val: %02X\n", newValue);
+//  printf("new val: %02X\n", data[byteIndex]);
+//  printf("~~~~~~~~~~~~\n");
+//}
+
+typedef enum
+{
+  TYPE_INT,
+  TYPE_FLOAT,
+  NUM_VAR_TYPES // Special value to represent the total number of DTC codes
+} var_type;
+
+typedef enum
+{
+  BYTE_ORDER_INTEL,    // little endian, what J1939 uses. Zero so existing tables don't have to say it
+  BYTE_ORDER_MOTOROLA, // big endian: the field's higher bits continue in the previous byte
+  NUM_BYTE_ORDERS
+} byte_order;
+
+typedef struct
+{
+  uint32_t spnNum;
+  uint8_t byte; // we start counting this at 1 instead of 0, since non-programmers made the J1939 standard...
+  uint8_t bit;  // we start counting this at 1 instead of 0, since non-programmers made the J1939 standard...
+  uint8_t len;
+  float scaling;
+  int32_t offset;
+  var_type varType;
+  uint8_t byteOrder = BYTE_ORDER_INTEL; // byte_order. byte/bit always point at the field's LSB, for both orders
+  bool isSigned = false;                // two's complement, sign extended to 64 bits by the extractors
+  bool offsetInCounts = false;          // offset is in raw counts: (raw + offset) * scaling instead of raw * scaling + offset
+} spn_info;
+
+#define MAX_NUM_SPNS 30
+
+typedef struct
+{
+  uint8_t instanceNum;
+  uint16_t boxNum;
+  uint32_t pgn;
+  uint8_t format; // BDS_CAN_STD_DU8 or BDS_CAN_EXD_DU8
+  uint8_t prio;
+  uint8_t src;
+  uint8_t dest;
+  uint16_t cycle;
+  uint16_t offset;
+  uint16_t timeout;
+  uint16_t startTimeout;
+  uint32_t lenMax; // 8 on classic CAN, up to 64 (an FD length) on CAN FD
+  uint8_t data[CANFD_MAX_DATA_LEN];
+  spn_info spns[MAX_NUM_SPNS];
+} can_isobus_info;
+
+//---------------------------------------------------------------------------------------------------------
+// BIT-FIELD KERNEL
+// Every extractor/inserter goes through here. An SPN is compiled once into a descriptor (shift, mask,
+// byte order, sign), after which extracting is one 64-bit load plus a handful of ALU ops, without loops
+// or branches: Motorola fields are read from the byte swapped payload (selected with a mask, not an if),
+// and sign extension is a left shift followed by an arithmetic right shift (by 0 for unsigned fields).
+// Byte B (0-based) bit b sits at position 8B+b in the little endian payload and at 8(7-B)+b in the
+// swapped one, so a Motorola field whose LSB is at (B, b) continues upwards into byte B-1, B-2, ...
+// CAN FD payloads (up to 64 bytes) work the same way: every field gets an 8-byte window at byteOffset
+// that contains it, and "the payload" is that window. On classic CAN the window is the whole payload.
+// With AVX2, BitFieldExtractBatch() gathers the windows of 4 fields at once and decodes them in parallel.
+// That path needs -mavx2 (g++/clang) or /arch:AVX2 (MSVC). Neither the vcxproj configurations nor the
+// benchmark build line set it, so those builds run on any x64 CPU and use the scalar loop.
+//---------------------------------------------------------------------------------------------------------
+#define BITS_PER_PAYLOAD 64
+#define BYTES_PER_PAYLOAD 8
+
+#if defined(__AVX2__) && (defined(__x86_64__) || defined(_M_X64))
+#include <immintrin.h>
+#define BIT_FIELD_AVX2 1
+#endif
+
+typedef struct bit_field_t
+{
+  uint64_t mask;      // len ones, not shifted
+  uint64_t swapMask;  // ~0 = Motorola (work on the byte swapped payload), 0 = Intel
+  uint8_t shift;      // LSB position in the (possibly swapped) payload
+  uint8_t signShift;  // 64 - len for signed fields, 0 for unsigned ones
+  uint8_t len;
+  uint8_t byteOffset; // first byte of the 8-byte window holding the field, 0 on classic CAN
+} bit_field_ts;
+
+uint64_t LoadPayload64(const uint8_t data[8]) // little endian, compiles to a single load on x86/ARM
+{
+  return (uint64_t)data[0] | ((uint64_t)data[1] << 8) | ((uint64_t)data[2] << 16) | ((uint64_t)data[3] << 24)
+    | ((uint64_t)data[4] << 32) | ((uint64_t)data[5] << 40) | ((uint64_t)data[6] << 48) | ((uint64_t)data[7] << 56);
+}
+
+void StorePayload64(uint8_t data[8], uint64_t payload) // little endian, compiles to a single store on x86/ARM
+{
+  int i;
+  for (i = 0; i < BYTES_PER_PAYLOAD; i++)
+  {
+    data[i] = (uint8_t)(payload >> (BITS_PER_BYTE * i));
+  }
+}
+
+// telegrams shorter than 8 bytes are zero padded, so the field math stays the same
+uint64_t LoadTelegram64(const uint8_t telegram[], uint8_t sizeOfTelegram)
+{
+  if (sizeOfTelegram >= BYTES_PER_PAYLOAD)
+    return LoadPayload64(telegram);
+  uint8_t padded[BYTES_PER_PAYLOAD] = {0};
+  memcpy(padded, telegram, sizeOfTelegram);
+  return LoadPayload64(padded);
+}
+
+uint64_t ByteSwap64(uint64_t x)
+{
+#ifdef _MSC_VER
+  return _byteswap_uint64(x);
+#else
+  return __builtin_bswap64(x);
+#endif
+}
+
+/**
+ * @brief Compiles a field position into a descriptor for `BitFieldExtract()` / `BitFieldInsert()`.
+ *
+ * @param byteIndex byte of the field's LSB, 0-based
+ * @param bitIndex bit of the field's LSB within that byte, 0-based
+ * @param len 1..64 bits, a field can't span more than 8 bytes (so at most 57 bits unless byte aligned)
+ * @param byteOrder BYTE_ORDER_INTEL or BYTE_ORDER_MOTOROLA
+ * @param sizeOfTelegram the field has to fit in this many bytes (at most 64)
+ * @return 0 on success, -1 if the field doesn't fit
+ */
+int BitFieldCompile(uint8_t byteIndex, uint8_t bitIndex, uint8_t len, uint8_t byteOrder, bool isSigned, uint32_t sizeOfTelegram, bit_field_ts* field)
+{
+  uint32_t numBits = BITS_PER_BYTE * sizeOfTelegram;
+  uint32_t lastWindow = (sizeOfTelegram > BYTES_PER_PAYLOAD) ? sizeOfTelegram - BYTES_PER_PAYLOAD : 0; // short telegrams are zero padded to 8
+  if (len == 0 || len > BITS_PER_PAYLOAD || bitIndex >= BITS_PER_BYTE || byteOrder >= NUM_BYTE_ORDERS || sizeOfTelegram > CANFD_MAX_DATA_LEN)
+    return -1;
+  if (byteOrder == BYTE_ORDER_INTEL)
+  {
+    if ((uint32_t)(BITS_PER_BYTE * byteIndex + bitIndex + len) > numBits) // Check if we are asking for something outside of telegram's allocation
+      return -1;
+    field->byteOffset = (byteIndex < lastWindow) ? byteIndex : lastWindow;
+    field->shift = BITS_PER_BYTE * (byteIndex - field->byteOffset) + bitIndex;
+    if (field->shift + len > BITS_PER_PAYLOAD) // spans more than 8 bytes
+      return -1;
+    field->swapMask = 0;
+  }
+  else
+  {
+    if ((uint32_t)(BITS_PER_BYTE * byteIndex) >= numBits)
+      return -1;
+    field->byteOffset = (byteIndex >= BYTES_PER_PAYLOAD - 1) ? byteIndex - (BYTES_PER_PAYLOAD - 1) : 0;
+    field->shift = BITS_PER_BYTE * (BYTES_PER_PAYLOAD - 1 - (byteIndex - field->byteOffset)) + bitIndex;
+    if (field->shift + len > BITS_PER_PAYLOAD) // runs past byte 0 or spans more than 8 bytes
+      return -1;
+    field->swapMask = ~0ull;
+  }
+  field->mask = ~0ull >> (BITS_PER_PAYLOAD - len);
+  field->signShift = isSigned ? BITS_PER_PAYLOAD - len : 0;
+  field->len = len;
+  return 0;
+}
+
+// same for an spn_info (1-based byte/bit) of a message with lenMax bytes
+int BitFieldFromSpn(const spn_info* spn, uint32_t lenMax, bit_field_ts* field)
+{
+  if (spn->byte == 0 || spn->bit == 0)
+    return -1;
+  return BitFieldCompile(spn->byte - 1, spn->bit - 1, spn->len, spn->byteOrder, spn->isSigned, lenMax, field); // These values start from 1, not 0
+}
+
+// descriptor table for all SPNs of a message. Returns the number of SPNs, or -1 if one doesn't fit
+int BitFieldCompileMessage(const can_isobus_info* messageData, bit_field_ts fields[MAX_NUM_SPNS])
+{
+  int i;
+  for (i = 0; i < MAX_NUM_SPNS && messageData->spns[i].len != 0; i++)
+  {
+    if (BitFieldFromSpn(&messageData->spns[i], messageData->lenMax, &fields[i]) != 0)
+      return -1;
+  }
+  return i;
+}
+
+// payload bits covered by the field, in little endian positions of its window (the payload on classic CAN)
+uint64_t BitFieldPayloadMask(const bit_field_ts* field)
+{
+  uint64_t mask = field->mask << field->shift;
+  return mask ^ ((mask ^ ByteSwap64(mask)) & field->swapMask);
+}
+
+// raw value, sign extended to 64 bits if the field is signed (read it back as int64_t then)
+uint64_t BitFieldExtract(const bit_field_ts* field, uint64_t payload)
+{
+  uint64_t ordered = payload ^ ((payload ^ ByteSwap64(payload)) & field->swapMask);
+  uint64_t val = (ordered >> field->shift) & field->mask;
+  return (uint64_t)((int64_t)(val << field->signShift) >> field->signShift);
+}
+
+// returns the payload with the field replaced by the low len bits of value
+uint64_t BitFieldInsert(const bit_field_ts* field, uint64_t payload, uint64_t value)
+{
+  uint64_t ordered = payload ^ ((payload ^ ByteSwap64(payload)) & field->swapMask);
+  ordered = (ordered & ~(field->mask << field->shift)) | ((value & field->mask) << field->shift);
+  return ordered ^ ((ordered ^ ByteSwap64(ordered)) & field->swapMask);
+}
+
+// BitFieldExtract() straight from a classic or FD payload, data has to hold at least 8 bytes
+uint64_t BitFieldExtractData(const bit_field_ts* field, const uint8_t data[])
+{
+  return BitFieldExtract(field, LoadPayload64(&data[field->byteOffset]));
+}
+
+void BitFieldInsertData(const bit_field_ts* field, uint8_t data[], uint64_t value)
+{
+  StorePayload64(&data[field->byteOffset], BitFieldInsert(field, LoadPayload64(&data[field->byteOffset]), value));
+}
+
+// All SPNs of a message as arrays, one lane per SPN, padded with zero-mask lanes to a multiple of 4.
+// Sign extension is (val ^ signBit) - signBit here, AVX2 has no variable arithmetic 64-bit shift.
+#define BIT_FIELD_BATCH_MAX ((MAX_NUM_SPNS + 3) & ~3)
+
+typedef struct bit_field_batch_t
+{
+  alignas(32) uint64_t mask[BIT_FIELD_BATCH_MAX];
+  alignas(32) uint64_t swapMask[BIT_FIELD_BATCH_MAX];
+  alignas(32) uint64_t shift[BIT_FIELD_BATCH_MAX];
+  alignas(32) uint64_t signBit[BIT_FIELD_BATCH_MAX]; // 1 << (len - 1) for signed fields, 0 for unsigned ones
+  alignas(16) int32_t byteOffset[BIT_FIELD_BATCH_MAX];
+  uint8_t numFields;
+} bit_field_batch_ts;
+
+// Returns the number of SPNs, or -1 if one doesn't fit
+int BitFieldBatchCompile(const can_isobus_info* messageData, bit_field_batch_ts* batch)
+{
+  bit_field_ts fields[MAX_NUM_SPNS];
+  int numFields = BitFieldCompileMessage(messageData, fields);
+  if (numFields < 0)
+    return -1;
+  memset(batch, 0, sizeof(*batch));
+  int i;
+  for (i = 0; i < numFields; i++)
+  {
+    batch->mask[i] = fields[i].mask;
+    batch->swapMask[i] = fields[i].swapMask;
+    batch->shift[i] = fields[i].shift;
+    batch->signBit[i] = (fields[i].signShift != 0) ? 1ull << (fields[i].len - 1) : 0;
+    batch->byteOffset[i] = fields[i].byteOffset;
+  }
+  batch->numFields = (uint8_t)numFields;
+  return numFields;
+}
+
+/**
+ * @brief Extracts all SPNs of a batch from one payload, same results as `BitFieldExtract()` per SPN.
+ *
+ * @param data classic or FD payload, at least 8 bytes
+ * @param out raw values, BIT_FIELD_BATCH_MAX entries (the padding lanes are written as 0)
+ * @return number of SPNs
+ */
+uint8_t BitFieldExtractBatch(const bit_field_batch_ts* batch, const uint8_t data[], uint64_t out[BIT_FIELD_BATCH_MAX])
+{
+  int i = 0;
+#ifdef BIT_FIELD_AVX2
+  const __m256i byteSwap = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  for (; i < batch->numFields; i += 4)
+  {
+    __m128i offsets = _mm_load_si128((const __m128i*)&batch->byteOffset[i]);
+    __m256i words = _mm256_i32gather_epi64((const long long*)data, offsets, 1); // 4 unaligned 8-byte windows
+    __m256i swapMask = _mm256_load_si256((const __m256i*)&batch->swapMask[i]);
+    __m256i ordered = _mm256_xor_si256(words, _mm256_and_si256(_mm256_xor_si256(words, _mm256_shuffle_epi8(words, byteSwap)), swapMask));
+    __m256i val = _mm256_and_si256(_mm256_srlv_epi64(ordered, _mm256_load_si256((const __m256i*)&batch->shift[i])),
+      _mm256_load_si256((const __m256i*)&batch->mask[i]));
+    __m256i signBit = _mm256_load_si256((const __m256i*)&batch->signBit[i]);
+    _mm256_storeu_si256((__m256i*)&out[i], _mm256_sub_epi64(_mm256_xor_si256(val, signBit), signBit));
+  }
+#endif
+  for (; i < batch->numFields; i++)
+  {
+    uint64_t payload = LoadPayload64(&data[batch->byteOffset[i]]);
+    uint64_t ordered = payload ^ ((payload ^ ByteSwap64(payload)) & batch->swapMask[i]);
+    uint64_t val = (ordered >> batch->shift[i]) & batch->mask[i];
+    out[i] = (val ^ batch->signBit[i]) - batch->signBit[i];
+  }
+  return batch->numFields;
+}
+
+int ExtractValueFromCanTelegram(can_isobus_info messageData, int spnInfoIndex, uint64_t* output)
+{
+  TRACE_SCOPE(TRACE_EXTRACT_VALUE);
+  bit_field_ts field;
+  if (BitFieldFromSpn(&messageData.spns[spnInfoIndex], messageData.lenMax, &field) != 0)
+    return -1; // Return FSC_ERR if we are going to overrun the array
+  *output = BitFieldExtractData(&field, messageData.data);
+  return 0;
+}
+
+// the offset in the SPN's physical unit, however the table stores it
+float SpnPhysicalOffset(const spn_info* spn)
+{
+  return spn->offsetInCounts ? (float)((double)spn->offset * spn->scaling) : (float)spn->offset;
+}
+
+void ScaleAndOffset_Float(uint64_t inRawVal, spn_info spn, float* outVal)
+{
+  if (spn.offsetInCounts)
+    *outVal = (float)(((int64_t)inRawVal + spn.offset) * spn.scaling); // exact for raw == -offset
+  else if (spn.isSigned)
+    *outVal = (float)((int64_t)inRawVal * spn.scaling + spn.offset);
+  else
+    *outVal = (float)(inRawVal * spn.scaling + spn.offset);
+}
+
+void ScaleAndOffset_Int(uint64_t inRawVal, spn_info spn, int* outVal)
+{
+  if (spn.offsetInCounts)
+    *outVal = (int)(((int64_t)inRawVal + spn.offset) * (int)spn.scaling);
+  else
+    *outVal = (int)((int64_t)inRawVal * (int)spn.scaling + spn.offset); // same bits for unsigned raw values below 2^63
+}
+
+void ScaleAndOffset(uint64_t inRawVal, spn_info spn, void* outVal)
+{
+  switch (spn.varType)
+  {
+  case TYPE_INT:
+    ScaleAndOffset_Int(inRawVal, spn, (int*)outVal);
+    break;
+  case TYPE_FLOAT:
+    ScaleAndOffset_Float(inRawVal, spn, (float*)outVal);
+    break;
+  default: // do nothing for now...
+    break;
+  }
+}
+
+typedef enum
+{
+  MM7_TX2_ROLL_RATE,
+  MM7_TX2_CLU_STAT,
+  MM7_TX2_ROLL_RATE_STAT,
+  MM7_TX2_CLU_DIAG,
+  MM7_TX2_AX,
+  MM7_TX2_MSG_CNT,
+  MM7_TX2_AX_STAT,
+  MM7_TX2_CRC,
+  MM7_TX2_NUM
+} PGN_MM7_TX2;
+
+can_isobus_info INFO_MM7_A_TX2 = {
+    .instanceNum = 1,
+    .boxNum = 11,
+    .format = 0,
+    .cycle = 0,
+    .offset = 0,
+    .timeout = 2500,
+    .startTimeout = 5000,
+    .lenMax = 8,
+    .spns = {
+        {.spnNum = 0, .byte = 1, .bit = 1, .len = 16, .scaling = 0.005, .offset = -0x8000, .varType = TYPE_FLOAT, .offsetInCounts = true},
+        {.spnNum = 0, .byte = 3, .bit = 1, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 3, .bit = 5, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 4, .bit = 1, .len = 8, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 5, .bit = 1, .len = 16, .scaling = 0.00125, .offset = -0x8000, .varType = TYPE_FLOAT, .offsetInCounts = true},
+        {.spnNum = 0, .byte = 7, .bit = 1, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 7, .bit = 5, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 8, .bit = 1, .len = 8, .scaling = 1, .offset = 0, .varType = TYPE_INT}}};
+
+// MM7 TX1 / TX3 use the same layout as TX2, with yaw rate + lateral and pitch rate + vertical acceleration
+typedef enum
+{
+  MM7_TX1_YAW_RATE,
+  MM7_TX1_CLU_STAT,
+  MM7_TX1_YAW_RATE_STAT,
+  MM7_TX1_CLU_DIAG,
+  MM7_TX1_AY,
+  MM7_TX1_MSG_CNT,
+  MM7_TX1_AY_STAT,
+  MM7_TX1_CRC,
+  MM7_TX1_NUM
+} PGN_MM7_TX1;
+
+can_isobus_info INFO_MM7_A_TX1 = {
+    .instanceNum = 1,
+    .boxNum = 10,
+    .format = 0,
+    .cycle = 0,
+    .offset = 0,
+    .timeout = 2500,
+    .startTimeout = 5000,
+    .lenMax = 8,
+    .spns = {
+        {.spnNum = 0, .byte = 1, .bit = 1, .len = 16, .scaling = 0.005, .offset = -0x8000, .varType = TYPE_FLOAT, .offsetInCounts = true},
+        {.spnNum = 0, .byte = 3, .bit = 1, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 3, .bit = 5, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 4, .bit = 1, .len = 8, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 5, .bit = 1, .len = 16, .scaling = 0.00125, .offset = -0x8000, .varType = TYPE_FLOAT, .offsetInCounts = true},
+        {.spnNum = 0, .byte = 7, .bit = 1, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 7, .bit = 5, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 8, .bit = 1, .len = 8, .scaling = 1, .offset = 0, .varType = TYPE_INT}}};
+
+typedef enum
+{
+  MM7_TX3_PITCH_RATE,
+  MM7_TX3_CLU_STAT,
+  MM7_TX3_PITCH_RATE_STAT,
+  MM7_TX3_CLU_DIAG,
+  MM7_TX3_AZ,
+  MM7_TX3_MSG_CNT,
+  MM7_TX3_AZ_STAT,
+  MM7_TX3_CRC,
+  MM7_TX3_NUM
+} PGN_MM7_TX3;
+
+can_isobus_info INFO_MM7_A_TX3 = {
+    .instanceNum = 1,
+    .boxNum = 13,
+    .format = 0,
+    .cycle = 0,
+    .offset = 0,
+    .timeout = 2500,
+    .startTimeout = 5000,
+    .lenMax = 8,
+    .spns = {
+        {.spnNum = 0, .byte = 1, .bit = 1, .len = 16, .scaling = 0.005, .offset = -0x8000, .varType = TYPE_FLOAT, .offsetInCounts = true},
+        {.spnNum = 0, .byte = 3, .bit = 1, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 3, .bit = 5, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 4, .bit = 1, .len = 8, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 5, .bit = 1, .len = 16, .scaling = 0.00125, .offset = -0x8000, .varType = TYPE_FLOAT, .offsetInCounts = true},
+        {.spnNum = 0, .byte = 7, .bit = 1, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 7, .bit = 5, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
+        {.spnNum = 0, .byte = 8, .bit = 1, .len = 8, .scaling = 1, .offset = 0, .varType = TYPE_INT}}};
+
+typedef enum
+{
+  CSTM_ENG_1_SPN_247,
+  CSTM_ENG_1_SPN_249,
+  CSTM_ENG_1_SPN_NUM
+} PGN_CSTM_ENG_1_SPNS;
+can_isobus_info INFO_CSTM_ENG_1 = {
+    .instanceNum = 1,
+    .boxNum = 12,
+    .pgn = 0x200,
+    .src = 0x00,
+    .timeout = 2500,
+    .startTimeout = 5000,
+    .lenMax = 8,
+    .spns = {
+        {.spnNum = 247, .byte = 1, .bit = 1, .len = 32, .scaling = 0.05f, .offset = 0, .varType = TYPE_FLOAT},   // Engine Total Hours of Operation
+        {.spnNum = 249, .byte = 5, .bit = 1, .len = 32, .scaling = 0.05f, .offset = 0, .varType = TYPE_FLOAT}} }; // Engine Total Revolutions
+
+
+int InsertValueToCanTelegram(can_isobus_info* messageData, int spnInfoIndex, uint64_t input)
+{
+  TRACE_SCOPE(TRACE_INSERT_VALUE);
+  bit_field_ts field;
+  if (BitFieldFromSpn(&messageData->spns[spnInfoIndex], messageData->lenMax, &field) != 0)
+    return -1; // Return FSC_ERR if we are going to overrun the array
+  BitFieldInsertData(&field, messageData->data, input);
+  return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// 29-BIT J1939 IDENTIFIER + PGN ROUTING
+// ID layout: prio(28-26) EDP(25) DP(24) PF(23-16) PS(15-8) SA(7-0). With PF < 240 (PDU1) PS is the
+// destination address and not part of the PGN, with PF >= 240 (PDU2) PS is the group extension.
+// Received IDs are routed to their can_isobus_info through a flat open-addressing table keyed by
+// (PGN, src): 16-byte entries, 4 per cache line, linear probing at <= 50% load, so a lookup is ~1 cache miss.
+//---------------------------------------------------------------------------------------------------------
+#define SHIFT_ID_PRIO 26
+#define SHIFT_ID_PGN 8
+#define MASK_3LSB 0x07
+#define MASK_18LSB 0x3FFFF
+#define MASK_ID_29BIT 0x1FFFFFFF
+#define MASK_PGN_PDU1 0x3FF00  // PDU1 PGNs don't contain the PS byte
+#define J1939_PDU2_MIN_PF 240
+
+#ifndef PGN_ROUTE_TABLE_BITS
+#define PGN_ROUTE_TABLE_BITS 13 // 8192 slots, up to 4096 definitions
+#endif
+#define PGN_ROUTE_TABLE_SIZE (1u << PGN_ROUTE_TABLE_BITS)
+#define PGN_ROUTE_MAX_ENTRIES (PGN_ROUTE_TABLE_SIZE / 2)
+#define PGN_ROUTE_EMPTY 0xFFFFFFFFu
+#define PGN_ROUTE_ANY_SRC J1939_GLOBAL_ADDR // route a PGN from every source that has no entry of its own
+
+uint32_t J1939BuildId(uint8_t prio, uint32_t pgn, uint8_t src, uint8_t dest)
+{
+  uint32_t id = ((uint32_t)(prio & MASK_3LSB) << SHIFT_ID_PRIO) | src;
+  if (((pgn >> SHIFT_8b) & MASK_8LSB) < J1939_PDU2_MIN_PF)
+    id |= ((pgn & MASK_PGN_PDU1) | dest) << SHIFT_ID_PGN;
+  else
+    id |= (pgn & MASK_18LSB) << SHIFT_ID_PGN;
+  return id;
+}
+
+void J1939ParseId(uint32_t id, uint8_t* prio, uint32_t* pgn, uint8_t* src, uint8_t* dest)
+{
+  uint32_t pgnField = (id >> SHIFT_ID_PGN) & MASK_18LSB;
+  *prio = (id >> SHIFT_ID_PRIO) & MASK_3LSB;
+  *src = id & MASK_8LSB;
+  if (((pgnField >> SHIFT_8b) & MASK_8LSB) < J1939_PDU2_MIN_PF)
+  {
+    *pgn = pgnField & MASK_PGN_PDU1;
+    *dest = pgnField & MASK_8LSB;
+  }
+  else
+  {
+    *pgn = pgnField;
+    *dest = J1939_GLOBAL_ADDR;
+  }
+}
+
+uint32_t J1939FrameToId(const j1939_frame_ts* frame)
+{
+  return J1939BuildId(frame->prio, frame->pgn, frame->src, frame->dest);
+}
+
+void J1939FrameFromId(uint32_t id, j1939_frame_ts* frame)
+{
+  J1939ParseId(id, &frame->prio, &frame->pgn, &frame->src, &frame->dest);
+}
+
+uint32_t CanIsobusInfoToId(const can_isobus_info* info)
+{
+  return J1939BuildId(info->prio, info->pgn, info->src, info->dest);
+}
+
+void CanIsobusInfoFromId(uint32_t id, can_isobus_info* info)
+{
+  J1939ParseId(id, &info->prio, &info->pgn, &info->src, &info->dest);
+}
+
+typedef struct pgn_route_entry_t
+{
+  uint32_t key; // pgn << 8 | src, PGN_ROUTE_EMPTY if unused
+  void* value;  // what the table routes to, e.g. a can_isobus_info* in pgnRoutes
+} pgn_route_entry_ts;
+
+typedef struct pgn_route_table_t
+{
+  alignas(64) pgn_route_entry_ts entries[PGN_ROUTE_TABLE_SIZE];
+  uint16_t numEntries;
+  bool ready;
+} pgn_route_table_ts;
+
+pgn_route_table_ts pgnRoutes; // receive path: (PGN, src) -> can_isobus_info
+
+uint32_t PgnRouteKey(uint32_t pgn, uint8_t src)
+{
+  return ((pgn & MASK_18LSB) << SHIFT_8b) | src;
+}
+
+uint32_t PgnRouteSlot(uint32_t key)
+{
+  return (key * 0x9E3779B1u) >> (32 - PGN_ROUTE_TABLE_BITS); // fibonacci hashing, the top bits are the well mixed ones
+}
+
+// key of a raw 29-bit ID: PDU1 IDs without their destination byte
+uint32_t PgnRouteKeyFromId(uint32_t id)
+{
+  uint32_t pgnField = (id >> SHIFT_ID_PGN) & MASK_18LSB;
+  if (((pgnField >> SHIFT_8b) & MASK_8LSB) < J1939_PDU2_MIN_PF)
+    pgnField &= MASK_PGN_PDU1;
+  return PgnRouteKey(pgnField, id & MASK_8LSB);
+}
+
+void PgnRouteTableClear(pgn_route_table_ts* table)
+{
+  uint32_t i;
+  for (i = 0; i < PGN_ROUTE_TABLE_SIZE; i++)
+  {
+    table->entries[i].key = PGN_ROUTE_EMPTY;
+    table->entries[i].value = NULL;
+  }
+  table->numEntries = 0;
+  table->ready = true;
+}
+
+/**
+ * @brief Routes `key` to `value`.
+ *
+ * @param replace whether an existing entry for key gets the new value
+ * @return 0 on success, -1 if the table is full or key is already routed and replace is false
+ */
+int PgnRouteTablePut(pgn_route_table_ts* table, uint32_t key, void* value, bool replace)
+{
+  if (!table->ready)
+    PgnRouteTableClear(table);
+  uint32_t slot = PgnRouteSlot(key);
+  while (table->entries[slot].key != PGN_ROUTE_EMPTY)
+  {
+    if (table->entries[slot].key == key)
+    {
+      if (!replace)
+        return -1;
+      table->entries[slot].value = value;
+      return 0;
+    }
+    slot = (slot + 1) & (PGN_ROUTE_TABLE_SIZE - 1);
+  }
+  if (table->numEntries >= PGN_ROUTE_MAX_ENTRIES)
+    return -1;
+  table->entries[slot].key = key;
+  table->entries[slot].value = value;
+  table->numEntries++;
+  return 0;
+}
+
+void* PgnRouteTableFind(const pgn_route_table_ts* table, uint32_t key)
+{
+  if (!table->ready)
+    return NULL;
+  uint32_t slot = PgnRouteSlot(key);
+  for (;;) // the table is never more than half full, so this always hits an empty slot
+  {
+    uint32_t entryKey = table->entries[slot].key;
+    if (entryKey == key)
+      return table->entries[slot].value;
+    if (entryKey == PGN_ROUTE_EMPTY)
+      return NULL;
+    slot = (slot + 1) & (PGN_ROUTE_TABLE_SIZE - 1);
+  }
+}
+
+// exact (PGN, src) first, then the PGN_ROUTE_ANY_SRC entry
+void* PgnRouteTableLookup(const pgn_route_table_ts* table, uint32_t key)
+{
+  void* value = PgnRouteTableFind(table, key);
+  if (value == NULL && (key & MASK_8LSB) != PGN_ROUTE_ANY_SRC)
+    value = PgnRouteTableFind(table, (key & ~(uint32_t)MASK_8LSB) | PGN_ROUTE_ANY_SRC);
+  return value;
+}
+
+void PgnRouteClear(void)
+{
+  PgnRouteTableClear(&pgnRoutes);
+}
+
+/**
+ * @brief Routes frames with `pgn` from `src` to `info`. Use `PGN_ROUTE_ANY_SRC` to catch every source
+ *			that doesn't have its own entry.
+ *
+ * @return 0 on success, -1 if the table is full or (pgn, src) is already routed
+ */
+int PgnRouteAdd(uint32_t pgn, uint8_t src, can_isobus_info* info)
+{
+  return PgnRouteTablePut(&pgnRoutes, PgnRouteKey(pgn, src), info, false);
+}
+
+// routes a definition by its own pgn/src fields
+int PgnRouteAddInfo(can_isobus_info* info)
+{
+  return PgnRouteAdd(info->pgn, info->src, info);
+}
+
+can_isobus_info* PgnRouteFind(uint32_t key)
+{
+  return (can_isobus_info*)PgnRouteTableFind(&pgnRoutes, key);
+}
+
+can_isobus_info* PgnRouteLookup(uint32_t pgn, uint8_t src)
+{
+  return (can_isobus_info*)PgnRouteTableLookup(&pgnRoutes, PgnRouteKey(pgn, src));
+}
+
+// first step of the receive path: raw 29-bit ID -> message definition, NULL if nobody wants it
+can_isobus_info* PgnRouteLookupId(uint32_t id)
+{
+  return (can_isobus_info*)PgnRouteTableLookup(&pgnRoutes, PgnRouteKeyFromId(id));
+}
+
+//---------------------------------------------------------------------------------------------------------
+// CHANGE-DETECTION DECODING
+// Most cyclic frames repeat their last payload. Keep the last 8 bytes per message, XOR the new frame
+// against them, and only decode the SPNs whose bits overlap a changed bit (precomputed mask per SPN).
+// The per-SPN masks come from the bit-field descriptors, so Motorola and signed SPNs work here too.
+//---------------------------------------------------------------------------------------------------------
+
+uint8_t CountTrailingZeros32(uint32_t x) // x must not be 0
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, x);
+  return (uint8_t)index;
+#else
+  return (uint8_t)__builtin_ctz(x);
+#endif
+}
+
+typedef struct can_change_detect_t
+{
+  uint64_t lastPayload;
+  uint64_t spnMasks[MAX_NUM_SPNS];  // payload bits covered by each SPN, in place
+  bit_field_ts fields[MAX_NUM_SPNS];
+  uint8_t numSpns;
+  bool primed;                      // false until the first frame, which reports every SPN as changed
+} can_change_detect_ts;
+
+/**
+ * @brief Precomputes the per-SPN masks for `messageData`. Call once per message before `DecodeChangedSpns()`.
+ *
+ * @return 0 on success, -1 if an SPN doesn't fit in the 8-byte payload (CAN FD messages aren't supported)
+ */
+int InitChangeDetect(const can_isobus_info* messageData, can_change_detect_ts* cd)
+{
+  cd->lastPayload = 0;
+  cd->numSpns = 0;
+  cd->primed = false;
+  if (messageData->lenMax > BYTES_PER_PAYLOAD)
+    return -1;
+  int numSpns = BitFieldCompileMessage(messageData, cd->fields);
+  if (numSpns < 0)
+    return -1;
+  int i;
+  for (i = 0; i < numSpns; i++)
+  {
+    cd->spnMasks[i] = BitFieldPayloadMask(&cd->fields[i]);
+  }
+  cd->numSpns = numSpns;
+  return 0;
+}
+
+/**
+ * @brief Compares a new payload against the last one and decodes only the SPNs that changed.
+ *			Scale the results with `ScaleAndOffset(rawVals[i], messageData.spns[i], ...)` for each set bit i.
+ *
+ * @param *cd state from `InitChangeDetect()`, updated with the new payload
+ * @param data received payload
+ * @param rawVals raw value of every changed SPN, other entries are left alone
+ * @return bit i set = SPN i changed (and rawVals[i] is new). 0 = nothing to publish.
+ */
+uint32_t DecodeChangedSpns(can_change_detect_ts* cd, const uint8_t data[8], uint64_t rawVals[MAX_NUM_SPNS])
+{
+  uint64_t payload = LoadPayload64(data);
+  uint64_t diff = cd->primed ? (payload ^ cd->lastPayload) : ~0ull;
+  cd->lastPayload = payload;
+  cd->primed = true;
+  if (diff == 0)
+    return 0; // the common case: same frame as last time
+
+  uint32_t changed = 0;
+  int i;
+  for (i = 0; i < cd->numSpns; i++)
+  {
+    changed |= (uint32_t)((diff & cd->spnMasks[i]) != 0) << i;
+  }
+  uint32_t pending = changed;
+  while (pending != 0)
+  {
+    uint8_t spn = CountTrailingZeros32(pending);
+    rawVals[spn] = BitFieldExtract(&cd->fields[spn], payload);
+    pending &= pending - 1;
+  }
+  return changed;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// STREAMING PER-SPN STATISTICS
+// Every ingest thread owns a shard with its own cache-line aligned accumulators, so nothing is shared on
+// the hot path. Time is cut into panes of paneLength ms. When a shard's samples cross into a new pane it
+// seals the old one (release store), and the collector merges a pane once every shard has sealed it.
+// Tumbling window = 1 pane, sliding window = the last windowPanes panes, re-emitted every pane.
+// A shard never runs more than SPN_STATS_PANE_RING panes ahead of the collector; if the collector falls
+// behind, late samples are folded into the shard's current pane and counted in `overruns`.
+//---------------------------------------------------------------------------------------------------------
+#define SPN_STATS_HIST_BUCKETS 16
+#define SPN_STATS_PANE_RING 4
+#define SPN_STATS_MAX_SHARDS 32
+#define SPN_STATS_MAX_WINDOW_PANES 255
+#define SPN_STATS_NO_PANE 0xFFFFFFFFFFFFFFFFull
+
+typedef struct alignas(64) spn_stat_accum_t
+{
+  uint64_t count;
+  double sum;
+  float min;
+  float max;
+  uint32_t hist[SPN_STATS_HIST_BUCKETS];
+} spn_stat_accum_ts;
+
+typedef struct spn_stat_window_t
+{
+  uint64_t count;
+  float min;
+  float max;
+  float mean;
+  uint32_t hist[SPN_STATS_HIST_BUCKETS];
+} spn_stat_window_ts;
+
+typedef struct spn_stats_hist_config_t
+{
+  float histMin;
+  float bucketsPerUnit; // SPN_STATS_HIST_BUCKETS / (histMax - histMin)
+} spn_stats_hist_config_ts;
+
+typedef struct alignas(64) spn_stats_shard_t
+{
+  spn_stat_accum_ts* accum;                  // [SPN_STATS_PANE_RING][numSpns], owned by the ingest thread
+  uint64_t paneOfSlot[SPN_STATS_PANE_RING];  // which pane each ring slot holds
+  uint64_t currentPane;
+  uint64_t overruns;
+  std::atomic<uint64_t> sealedPanes;         // every pane below this is complete
+} spn_stats_shard_ts;
+
+typedef struct spn_stats_t
+{
+  uint32_t numSpns;
+  uint32_t paneLength;
+  uint8_t windowPanes;
+  uint8_t numShards;
+  uint64_t startTime;
+  spn_stats_hist_config_ts* histConfig;      // [numSpns], read only after init
+  spn_stats_shard_ts shards[SPN_STATS_MAX_SHARDS];
+  alignas(64) std::atomic<uint64_t> collectedPanes;
+  spn_stat_accum_ts* history;                // collector only: [windowPanes][numSpns] merged panes
+} spn_stats_ts;
+
+void SpnStatAccumReset(spn_stat_accum_ts* accum)
+{
+  memset(accum, 0, sizeof(*accum));
+  accum->min = INFINITY;
+  accum->max = -INFINITY;
+}
+
+void SpnStatAccumMerge(spn_stat_accum_ts* dst, const spn_stat_accum_ts* src)
+{
+  dst->count += src->count;
+  dst->sum += src->sum;
+  dst->min = (src->min < dst->min) ? src->min : dst->min;
+  dst->max = (src->max > dst->max) ? src->max : dst->max;
+  int i;
+  for (i = 0; i < SPN_STATS_HIST_BUCKETS; i++)
+  {
+    dst->hist[i] += src->hist[i];
+  }
+}
+
+/**
+ * @brief Sets up an aggregator. Allocates everything up front, ingest never allocates.
+ *
+ * @param numSpns number of signals, ingest takes an index below this
+ * @param numShards number of ingest threads, each one passes its own shard index
+ * @param paneLength pane length in ms
+ * @param windowPanes 1 = tumbling windows of paneLength, N = sliding window over the last N panes
+ * @param startTime timestamp where pane 0 starts
+ * @return 0 on success, -1 on bad parameters
+ */
+int SpnStatsInit(spn_stats_ts* stats, uint32_t numSpns, uint8_t numShards, uint32_t paneLength, uint8_t windowPanes, uint64_t startTime)
+{
+  if (numSpns == 0 || numShards == 0 || numShards > SPN_STATS_MAX_SHARDS || paneLength == 0 || windowPanes == 0)
+    return -1;
+  stats->numSpns = numSpns;
+  stats->numShards = numShards;
+  stats->paneLength = paneLength;
+  stats->windowPanes = windowPanes;
+  stats->startTime = startTime;
+  stats->histConfig = new spn_stats_hist_config_ts[numSpns];
+  stats->history = new spn_stat_accum_ts[(size_t)windowPanes * numSpns];
+  uint32_t i;
+  for (i = 0; i < numSpns; i++)
+  {
+    stats->histConfig[i].histMin = 0.0f;
+    stats->histConfig[i].bucketsPerUnit = 0.0f; // everything lands in bucket 0 until SpnStatsSetHistogram()
+  }
+  for (i = 0; i < (uint32_t)windowPanes * numSpns; i++)
+  {
+    SpnStatAccumReset(&stats->history[i]);
+  }
+  for (i = 0; i < numShards; i++)
+  {
+    spn_stats_shard_ts* shard = &stats->shards[i];
+    shard->accum = new spn_stat_accum_ts[(size_t)SPN_STATS_PANE_RING * numSpns];
+    uint32_t j;
+    for (j = 0; j < SPN_STATS_PANE_RING * numSpns; j++)
+    {
+      SpnStatAccumReset(&shard->accum[j]);
+    }
+    for (j = 0; j < SPN_STATS_PANE_RING; j++)
+    {
+      shard->paneOfSlot[j] = SPN_STATS_NO_PANE;
+    }
+    shard->paneOfSlot[0] = 0;
+    shard->currentPane = 0;
+    shard->overruns = 0;
+    shard->sealedPanes.store(0, std::memory_order_relaxed);
+  }
+  stats->collectedPanes.store(0, std::memory_order_release);
+  return 0;
+}
+
+void SpnStatsFree(spn_stats_ts* stats)
+{
+  int i;
+  for (i = 0; i < stats->numShards; i++)
+  {
+    delete[] stats->shards[i].accum;
+  }
+  delete[] stats->histConfig;
+  delete[] stats->history;
+}
+
+// fixed-width histogram between histMin and histMax, values outside go to the first/last bucket. Call before ingesting.
+void SpnStatsSetHistogram(spn_stats_ts* stats, uint32_t spn, float histMin, float histMax)
+{
+  stats->histConfig[spn].histMin = histMin;
+  stats->histConfig[spn].bucketsPerUnit = (histMax > histMin) ? SPN_STATS_HIST_BUCKETS / (histMax - histMin) : 0.0f;
+}
+
+// moves a shard to `pane`, sealing everything before it. Only the shard's own thread calls this.
+void SpnStatsAdvanceShard(spn_stats_ts* stats, spn_stats_shard_ts* shard, uint64_t pane)
+{
+  uint64_t limit = stats->collectedPanes.load(std::memory_order_acquire) + SPN_STATS_PANE_RING - 1; // don't reuse a slot the collector hasn't read
+  if (pane > limit)
+  {
+    pane = limit;
+    shard->overruns++;
+  }
+  if (pane <= shard->currentPane)
+    return;
+  uint8_t slot = pane % SPN_STATS_PANE_RING;
+  uint32_t i;
+  for (i = 0; i < stats->numSpns; i++)
+  {
+    SpnStatAccumReset(&shard->accum[slot * stats->numSpns + i]);
+  }
+  shard->paneOfSlot[slot] = pane;
+  shard->currentPane = pane;
+  shard->sealedPanes.store(pane, std::memory_order_release);
+}
+
+/**
+ * @brief Adds one sample. Lock free, only touches the calling thread's shard.
+ *
+ * @param shardIndex index of the calling thread's shard, one thread per shard
+ * @param spn signal index
+ * @param value scaled value, e.g. from ScaleAndOffset(). NaN is dropped, the pane still advances
+ * @param timestamp sample time in ms, same clock as startTime
+ */
+void SpnStatsIngest(spn_stats_ts* stats, uint8_t shardIndex, uint32_t spn, float value, uint64_t timestamp)
+{
+  spn_stats_shard_ts* shard = &stats->shards[shardIndex];
+  uint64_t pane = (timestamp > stats->startTime) ? (timestamp - stats->startTime) / stats->paneLength : 0;
+  if (pane > shard->currentPane)
+    SpnStatsAdvanceShard(stats, shard, pane);
+  if (isnan(value)) // would poison sum/min/max for the whole window and has no bucket
+    return;
+
+  spn_stat_accum_ts* accum = &shard->accum[(shard->currentPane % SPN_STATS_PANE_RING) * stats->numSpns + spn];
+  const spn_stats_hist_config_ts* hist = &stats->histConfig[spn];
+  float pos = (value - hist->histMin) * hist->bucketsPerUnit;
+  int bucket = (pos < 0.0f) ? 0 : (pos >= SPN_STATS_HIST_BUCKETS) ? SPN_STATS_HIST_BUCKETS - 1 : (int)pos;
+  accum->count++;
+  accum->sum += value;
+  accum->min = (value < accum->min) ? value : accum->min;
+  accum->max = (value > accum->max) ? value : accum->max;
+  accum->hist[bucket]++;
+}
+
+// lets a shard without samples seal its panes, so it doesn't hold up the collector. Call from the shard's own thread.
+void SpnStatsTick(spn_stats_ts* stats, uint8_t shardIndex, uint64_t current_time)
+{
+  spn_stats_shard_ts* shard = &stats->shards[shardIndex];
+  uint64_t pane = (current_time > stats->startTime) ? (current_time - stats->startTime) / stats->paneLength : 0;
+  if (pane > shard->currentPane)
+    SpnStatsAdvanceShard(stats, shard, pane);
+}
+
+/**
+ * @brief Collector side: merges the next pane once every shard sealed it and writes the window that ends
+ *			with it to out[numSpns]. Call from a single thread, as often as you like.
+ *
+ * @param out one window per SPN
+ * @param *windowEnd end of the window (exclusive), same clock as startTime
+ * @return true if a window was written, false if the next pane isn't complete yet
+ */
+bool SpnStatsCollect(spn_stats_ts* stats, spn_stat_window_ts out[], uint64_t* windowEnd)
+{
+  uint64_t pane = stats->collectedPanes.load(std::memory_order_relaxed);
+  int s;
+  for (s = 0; s < stats->numShards; s++)
+  {
+    if (stats->shards[s].sealedPanes.load(std::memory_order_acquire) <= pane)
+      return false;
+  }
+
+  spn_stat_accum_ts* merged = &stats->history[(pane % stats->windowPanes) * stats->numSpns];
+  uint8_t slot = pane % SPN_STATS_PANE_RING;
+  uint32_t i;
+  for (i = 0; i < stats->numSpns; i++)
+  {
+    SpnStatAccumReset(&merged[i]);
+  }
+  for (s = 0; s < stats->numShards; s++)
+  {
+    spn_stats_shard_ts* shard = &stats->shards[s];
+    if (shard->paneOfSlot[slot] != pane) // shard had no samples in this pane
+      continue;
+    for (i = 0; i < stats->numSpns; i++)
+    {
+      SpnStatAccumMerge(&merged[i], &shard->accum[slot * stats->numSpns + i]);
+    }
+  }
+  stats->collectedPanes.store(pane + 1, std::memory_order_release); // hands the slot back to the shards
+
+  uint8_t numPanes = (pane + 1 < stats->windowPanes) ? (uint8_t)(pane + 1) : stats->windowPanes;
+  for (i = 0; i < stats->numSpns; i++)
+  {
+    spn_stat_accum_ts window;
+    SpnStatAccumReset(&window);
+    uint8_t p;
+    for (p = 0; p < numPanes; p++)
+    {
+      SpnStatAccumMerge(&window, &stats->history[((pane - p) % stats->windowPanes) * stats->numSpns + i]);
+    }
+    out[i].count = window.count;
+    out[i].min = window.min;
+    out[i].max = window.max;
+    out[i].mean = (window.count != 0) ? (float)(window.sum / window.count) : 0.0f;
+    memcpy(out[i].hist, window.hist, sizeof(out[i].hist));
+  }
+  *windowEnd = stats->startTime + (pane + 1) * stats->paneLength;
+  return true;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// SHARDED MULTI-CORE DECODE PIPELINE
+//   rx threads --SPSC ring per (rx, worker)--> decode workers --SPSC ring per worker--> consumers
+// Frames are sharded to a worker by a hash of their PGN, so each message is always decoded by the
+// same core and nothing is shared between workers. Every ring has exactly one producer and one
+// consumer, so they only need acquire/release on head/tail, no locks or CAS. Workers drain their
+// rings in batches of PIPE_BATCH. Messages are found through a PGN routing table given to PipelineInit()
+// (usually &pgnRoutes), which has to be filled before PipelineStart() and must not change while the pipeline runs.
+//---------------------------------------------------------------------------------------------------------
+#define PIPE_MAX_RX 8
+#define PIPE_MAX_WORKERS 16
+#define PIPE_RX_RING_SIZE 4096    // power of 2
+#define PIPE_OUT_RING_SIZE 16384  // power of 2
+#define PIPE_BATCH 64
+
+template <typename T, uint32_t CAPACITY>
+struct spsc_ring
+{
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of 2");
+  alignas(64) std::atomic<uint32_t> head;  // next slot to read, written by the consumer
+  uint32_t cachedTail;                     // consumer's last look at tail
+  alignas(64) std::atomic<uint32_t> tail;  // next slot to write, written by the producer
+  uint32_t cachedHead;                     // producer's last look at head
+  alignas(64) T items[CAPACITY];
+};
+
+template <typename T, uint32_t CAPACITY>
+void SpscInit(spsc_ring<T, CAPACITY>* ring)
+{
+  ring->head.store(0, std::memory_order_relaxed);
+  ring->tail.store(0, std::memory_order_relaxed);
+  ring->cachedTail = 0;
+  ring->cachedHead = 0;
+}
+
+// producer side. false = ring full
+template <typename T, uint32_t CAPACITY>
+bool SpscPush(spsc_ring<T, CAPACITY>* ring, const T* item)
+{
+  uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+  if (tail - ring->cachedHead >= CAPACITY)
+  {
+    ring->cachedHead = ring->head.load(std::memory_order_acquire); // only touch the consumer's line when we look full
+    if (tail - ring->cachedHead >= CAPACITY)
+      return false;
+  }
+  ring->items[tail & (CAPACITY - 1)] = *item;
+  ring->tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+// consumer side. returns how many items were copied to out
+template <typename T, uint32_t CAPACITY>
+uint32_t SpscPopBatch(spsc_ring<T, CAPACITY>* ring, T out[], uint32_t maxItems)
+{
+  uint32_t head = ring->head.load(std::memory_order_relaxed);
+  if (ring->cachedTail == head)
+  {
+    ring->cachedTail = ring->tail.load(std::memory_order_acquire);
+    if (ring->cachedTail == head)
+      return 0;
+  }
+  uint32_t count = ring->cachedTail - head;
+  if (count > maxItems)
+    count = maxItems;
+  uint32_t i;
+  for (i = 0; i < count; i++)
+  {
+    out[i] = ring->items[(head + i) & (CAPACITY - 1)];
+  }
+  ring->head.store(head + count, std::memory_order_release);
+  return count;
+}
+
+typedef struct can_raw_frame_t
+{
+  uint64_t timestamp;
+  uint32_t id;       // 29-bit identifier
+  uint8_t len;
+  uint8_t data[8];   // zero padded past len
+} can_raw_frame_ts;
+
+typedef union
+{
+  int i;    // TYPE_INT
+  float f;  // TYPE_FLOAT
+} spn_value_tu;
+
+typedef struct decoded_spn_t
+{
+  uint64_t timestamp;
+  const can_isobus_info* msg;
+  uint64_t raw;
+  spn_value_tu value;  // ScaleAndOffset() output, msg->spns[spnIndex].varType says which member
+  uint8_t src;
+  uint8_t spnIndex;
+} decoded_spn_ts;
+
+// ExtractValueFromCanTelegram() for a bare payload, for callers that can't write to the shared can_isobus_info
+int ExtractValueFromPayload(const uint8_t data[8], const spn_info* spn, uint64_t* output)
+{
+  bit_field_ts field;
+  if (BitFieldFromSpn(spn, BYTES_PER_PAYLOAD, &field) != 0)
+    return -1;
+  *output = BitFieldExtract(&field, LoadPayload64(data));
+  return 0;
+}
+
+typedef struct alignas(64) pipe_worker_stats_t
+{
+  std::atomic<uint64_t> frames;
+  std::atomic<uint64_t> unrouted;  // no definition in the routing table
+  std::atomic<uint64_t> truncated; // shorter than the definition's lenMax, not decoded
+  std::atomic<uint64_t> dropped;   // output ring was full
+} pipe_worker_stats_ts;
+
+typedef struct decode_pipeline_t
+{
+  uint8_t numRx;
+  uint8_t numWorkers;
+  const pgn_route_table_ts* routes; // (PGN, src) -> can_isobus_info
+  std::atomic<bool> running;
+  spsc_ring<can_raw_frame_ts, PIPE_RX_RING_SIZE>* rxRings[PIPE_MAX_RX][PIPE_MAX_WORKERS];
+  spsc_ring<decoded_spn_ts, PIPE_OUT_RING_SIZE>* outRings[PIPE_MAX_WORKERS];
+  pipe_worker_stats_ts stats[PIPE_MAX_WORKERS];
+  std::thread workers[PIPE_MAX_WORKERS];
+} decode_pipeline_ts;
+
+uint8_t PipelineShard(const decode_pipeline_ts* pipe, uint32_t id)
+{
+  uint32_t pgnField = (id >> SHIFT_ID_PGN) & MASK_18LSB;
+  if (((pgnField >> SHIFT_8b) & MASK_8LSB) < J1939_PDU2_MIN_PF)
+    pgnField &= MASK_PGN_PDU1; // PDU1: same PGN to any destination goes to the same worker
+  return (uint8_t)(((uint64_t)(pgnField * 0x9E3779B1u) * pipe->numWorkers) >> 32);
+}
+
+int PipelineInit(decode_pipeline_ts* pipe, const pgn_route_table_ts* routes, uint8_t numRx, uint8_t numWorkers)
+{
+  if (numRx == 0 || numRx > PIPE_MAX_RX || numWorkers == 0 || numWorkers > PIPE_MAX_WORKERS)
+    return -1;
+  pipe->routes = routes;
+  pipe->numRx = numRx;
+  pipe->numWorkers = numWorkers;
+  pipe->running.store(false);
+  int r, w;
+  for (w = 0; w < numWorkers; w++)
+  {
+    for (r = 0; r < numRx; r++)
+    {
+      pipe->rxRings[r][w] = new spsc_ring<can_raw_frame_ts, PIPE_RX_RING_SIZE>;
+      SpscInit(pipe->rxRings[r][w]);
+    }
+    pipe->outRings[w] = new spsc_ring<decoded_spn_ts, PIPE_OUT_RING_SIZE>;
+    SpscInit(pipe->outRings[w]);
+    pipe->stats[w].frames.store(0);
+    pipe->stats[w].unrouted.store(0);
+    pipe->stats[w].truncated.store(0);
+    pipe->stats[w].dropped.store(0);
+  }
+  return 0;
+}
+
+void PipelineDecodeFrame(decode_pipeline_ts* pipe, uint8_t worker, const can_raw_frame_ts* frame)
+{
+  const can_isobus_info* msg = (const can_isobus_info*)PgnRouteTableLookup(pipe->routes, PgnRouteKeyFromId(frame->id));
+  if (msg == NULL)
+  {
+    pipe->stats[worker].unrouted.store(pipe->stats[worker].unrouted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return;
+  }
+  if (frame->len < msg->lenMax) // the zero padding would decode as real values
+  {
+    pipe->stats[worker].truncated.store(pipe->stats[worker].truncated.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return;
+  }
+  decoded_spn_ts out;
+  out.timestamp = frame->timestamp;
+  out.msg = msg;
+  out.src = frame->id & MASK_8LSB;
+  int i;
+  for (i = 0; i < MAX_NUM_SPNS && msg->spns[i].len != 0; i++)
+  {
+    if (ExtractValueFromPayload(frame->data, &msg->spns[i], &out.raw) != 0)
+      continue;
+    out.spnIndex = i;
+    ScaleAndOffset(out.raw, msg->spns[i], &out.value);
+    if (!SpscPush(pipe->outRings[worker], &out))
+      pipe->stats[worker].dropped.store(pipe->stats[worker].dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+}
+
+void PipelineWorker(decode_pipeline_ts* pipe, uint8_t worker)
+{
+  can_raw_frame_ts batch[PIPE_BATCH];
+  while (pipe->running.load(std::memory_order_relaxed))
+  {
+    uint32_t total = 0;
+    int r;
+    for (r = 0; r < pipe->numRx; r++)
+    {
+      uint32_t count = SpscPopBatch(pipe->rxRings[r][worker], batch, PIPE_BATCH);
+      uint32_t i;
+      for (i = 0; i < count; i++)
+      {
+        PipelineDecodeFrame(pipe, worker, &batch[i]);
+      }
+      total += count;
+    }
+    if (total == 0)
+      std::this_thread::yield();
+    else
+      pipe->stats[worker].frames.store(pipe->stats[worker].frames.load(std::memory_order_relaxed) + total, std::memory_order_relaxed);
+  }
+}
+
+void PipelineStart(decode_pipeline_ts* pipe)
+{
+  pipe->running.store(true);
+  int w;
+  for (w = 0; w < pipe->numWorkers; w++)
+  {
+    pipe->workers[w] = std::thread(PipelineWorker, pipe, (uint8_t)w);
+  }
+}
+
+// stops the workers. Frames still in the rx rings are not decoded.
+void PipelineStop(decode_pipeline_ts* pipe)
+{
+  pipe->running.store(false);
+  int w;
+  for (w = 0; w < pipe->numWorkers; w++)
+  {
+    if (pipe->workers[w].joinable())
+      pipe->workers[w].join();
+  }
+}
+
+void PipelineFree(decode_pipeline_ts* pipe)
+{
+  PipelineStop(pipe);
+  int r, w;
+  for (w = 0; w < pipe->numWorkers; w++)
+  {
+    for (r = 0; r < pipe->numRx; r++)
+    {
+      delete pipe->rxRings[r][w];
+    }
+    delete pipe->outRings[w];
+  }
+}
+
+/**
+ * @brief Hands a received frame to its decode worker. Each rx thread has to use its own rxIndex.
+ *
+ * @return true if queued, false if that worker's ring is full (caller decides: drop or retry)
+ */
+bool PipelinePush(decode_pipeline_ts* pipe, uint8_t rxIndex, const can_raw_frame_ts* frame)
+{
+  return SpscPush(pipe->rxRings[rxIndex][PipelineShard(pipe, frame->id)], frame);
+}
+
+// consumer side: one thread per worker output (or one thread polling all of them)
+uint32_t PipelinePoll(decode_pipeline_ts* pipe, uint8_t worker, decoded_spn_ts out[], uint32_t maxItems)
+{
+  return SpscPopBatch(pipe->outRings[worker], out, maxItems);
+}
+
+//---------------------------------------------------------------------------------------------------------
+// SHARED-MEMORY SIGNAL BOARD
+// Latest scaled value + timestamp of every SPN in a named shared memory block, so only one process has
+// to decode the bus. One writer process, any number of reader processes. Every slot has its own seqlock:
+// the writer makes the sequence odd, writes, and makes it even again; a reader retries if it saw an odd
+// sequence or the sequence changed under it. After opening there are no locks or syscalls, and the
+// writer never waits for readers. Slots are 64 bytes so writers of neighbouring slots don't share a line.
+//---------------------------------------------------------------------------------------------------------
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define SIGNAL_BOARD_MAGIC 0x424E5053 // "SPNB"
+#define SIGNAL_BOARD_VERSION 1
+#define SIGNAL_BOARD_NAME_LEN 64
+#define SHIFT_BOARD_KEY_SRC 24
+
+typedef struct alignas(64) signal_board_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t numSlots;
+  std::atomic<uint32_t> numUsed;  // slots [0, numUsed) have a key
+} signal_board_header_ts;
+
+typedef struct alignas(64) signal_slot_t
+{
+  std::atomic<uint32_t> seq;        // odd while the writer is in the middle of an update, 0 = never written
+  std::atomic<uint32_t> key;        // src << 24 | spn, set once by SignalBoardRegister()
+  std::atomic<uint64_t> valueBits;  // double
+  std::atomic<uint64_t> timestamp;
+} signal_slot_ts;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the signal board needs lock free 64-bit atomics in shared memory");
+
+typedef struct signal_board_t
+{
+  signal_board_header_ts* header;
+  signal_slot_ts* slots;
+  size_t size;
+  bool isWriter;
+#ifdef _WIN32
+  HANDLE mapping;
+#endif
+} signal_board_ts;
+
+size_t SignalBoardSize(uint32_t numSlots)
+{
+  return sizeof(signal_board_header_ts) + (size_t)numSlots * sizeof(signal_slot_ts);
+}
+
+// maps the named block. size == 0 opens an existing one read only and takes the size from its header
+void* SignalBoardMap(const char* name, size_t size, bool create, signal_board_ts* board)
+{
+#ifdef _WIN32
+  if (create)
+    board->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+  else
+    board->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+  if (board->mapping == NULL)
+    return NULL;
+  void* base = MapViewOfFile(board->mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+  if (base == NULL)
+    CloseHandle(board->mapping);
+  return base;
+#else
+  char shmName[SIGNAL_BOARD_NAME_LEN];
+  snprintf(shmName, sizeof(shmName), "/%s", name);
+  int fd = shm_open(shmName, create ? (O_CREAT | O_RDWR) : O_RDONLY, 0644);
+  if (fd < 0)
+    return NULL;
+  if (create && ftruncate(fd, (off_t)size) != 0)
+  {
+    close(fd);
+    return NULL;
+  }
+  if (!create)
+  {
+    signal_board_header_ts header;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || header.magic != SIGNAL_BOARD_MAGIC)
+    {
+      close(fd);
+      return NULL;
+    }
+    size = SignalBoardSize(header.numSlots);
+  }
+  void* base = mmap(NULL, size, create ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the memory alive
+  board->size = size;
+  return (base == MAP_FAILED) ? NULL : base;
+#endif
+}
+
+/**
+ * @brief Creates (or re-creates) the board as the single writer.
+ *
+ * @param name shared memory name, same string on the reader side
+ * @param numSlots how many SPNs the board can hold
+ * @return 0 on success, -1 if the shared memory couldn't be created
+ */
+int SignalBoardCreate(signal_board_ts* board, const char* name, uint32_t numSlots)
+{
+  size_t size = SignalBoardSize(numSlots);
+  void* base = SignalBoardMap(name, size, true, board);
+  if (base == NULL)
+    return -1;
+  board->header = (signal_board_header_ts*)base;
+  board->slots = (signal_slot_ts*)((uint8_t*)base + sizeof(signal_board_header_ts));
+  board->size = size;
+  board->isWriter = true;
+  memset(base, 0, size);
+  board->header->numSlots = numSlots;
+  board->header->version = SIGNAL_BOARD_VERSION;
+  board->header->numUsed.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  board->header->magic = SIGNAL_BOARD_MAGIC; // readers check this last
+  return 0;
+}
+
+// opens an existing board read only. -1 if it doesn't exist (yet) or isn't a signal board
+int SignalBoardOpen(signal_board_ts* board, const char* name)
+{
+  board->size = 0;
+  void* base = SignalBoardMap(name, 0, false, board);
+  if (base == NULL)
+    return -1;
+  board->header = (signal_board_header_ts*)base;
+  board->slots = (signal_slot_ts*)((uint8_t*)base + sizeof(signal_board_header_ts));
+  board->isWriter = false;
+  if (board->header->magic != SIGNAL_BOARD_MAGIC || board->header->version != SIGNAL_BOARD_VERSION)
+    return -1;
+#ifdef _WIN32
+  board->size = SignalBoardSize(board->header->numSlots);
+#endif
+  return 0;
+}
+
+void SignalBoardClose(signal_board_ts* board)
+{
+#ifdef _WIN32
+  UnmapViewOfFile(board->header);
+  CloseHandle(board->mapping);
+#else
+  munmap(board->header, board->size);
+#endif
+  board->header = NULL;
+  board->slots = NULL;
+}
+
+// removes the name, existing mappings stay valid. On Windows the block goes away with the last handle.
+void SignalBoardDestroy(const char* name)
+{
+#ifndef _WIN32
+  char shmName[SIGNAL_BOARD_NAME_LEN];
+  snprintf(shmName, sizeof(shmName), "/%s", name);
+  shm_unlink(shmName);
+#endif
+}
+
+uint32_t SignalBoardKey(uint32_t spnNum, uint8_t src)
+{
+  return ((uint32_t)src << SHIFT_BOARD_KEY_SRC) | (spnNum & 0xFFFFFF);
+}
+
+// writer: gives (spn, src) a slot. Returns the slot index, or -1 if the board is full
+int32_t SignalBoardRegister(signal_board_ts* board, uint32_t spnNum, uint8_t src)
+{
+  uint32_t used = board->header->numUsed.load(std::memory_order_relaxed);
+  if (!board->isWriter || used >= board->header->numSlots)
+    return -1;
+  board->slots[used].key.store(SignalBoardKey(spnNum, src), std::memory_order_relaxed);
+  board->header->numUsed.store(used + 1, std::memory_order_release);
+  return (int32_t)used;
+}
+
+// reader: looks up the slot of (spn, src) once, keep the index afterwards. -1 if the writer hasn't registered it
+int32_t SignalBoardFind(const signal_board_ts* board, uint32_t spnNum, uint8_t src)
+{
+  uint32_t key = SignalBoardKey(spnNum, src);
+  uint32_t used = board->header->numUsed.load(std::memory_order_acquire);
+  uint32_t i;
+  for (i = 0; i < used; i++)
+  {
+    if (board->slots[i].key.load(std::memory_order_relaxed) == key)
+      return (int32_t)i;
+  }
+  return -1;
+}
+
+void SignalBoardWrite(signal_board_ts* board, int32_t slotIndex, double value, uint64_t timestamp)
+{
+  signal_slot_ts* slot = &board->slots[slotIndex];
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint32_t seq = slot->seq.load(std::memory_order_relaxed);
+  slot->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release); // the odd sequence has to be visible before the data changes
+  slot->valueBits.store(bits, std::memory_order_relaxed);
+  slot->timestamp.store(timestamp, std::memory_order_relaxed);
+  slot->seq.store(seq + 2, std::memory_order_release);
+}
+
+// writer: publishes a pipeline result as a double
+void SignalBoardPublish(signal_board_ts* board, int32_t slotIndex, const decoded_spn_ts* decoded)
+{
+  double value = (decoded->msg->spns[decoded->spnIndex].varType == TYPE_INT) ? (double)decoded->value.i : (double)decoded->value.f;
+  SignalBoardWrite(board, slotIndex, value, decoded->timestamp);
+}
+
+/**
+ * @brief Reads the latest value of a slot without locking. Retries while the writer is updating it,
+ *			which takes a handful of ns, so this never waits long.
+ *
+ * @return true if *value / *timestamp are valid, false if the slot was never written
+ */
+bool SignalBoardRead(const signal_board_ts* board, int32_t slotIndex, double* value, uint64_t* timestamp)
+{
+  signal_slot_ts* slot = &board->slots[slotIndex];
+  uint32_t seqBefore;
+  uint32_t seqAfter;
+  uint64_t bits;
+  do
+  {
+    seqBefore = slot->seq.load(std::memory_order_acquire);
+    bits = slot->valueBits.load(std::memory_order_relaxed);
+    *timestamp = slot->timestamp.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire); // data loads can't move below the second sequence load
+    seqAfter = slot->seq.load(std::memory_order_relaxed);
+  } while ((seqBefore & 1) || seqBefore != seqAfter);
+  memcpy(value, &bits, sizeof(bits));
+  return seqBefore != 0;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// TRAFFIC REPLAY
+// Plays a candump log (`candump -l`, lines like "(1436509052.249713) can0 18FECA00#0102030405060708") back
+// into the decoders, at the recorded timing, N times faster, or as fast as possible. The whole log is
+// parsed into memory first so file I/O doesn't add jitter. Pacing is against real time (wallNanos(), so
+// it still works while setTimeSource() or SimRun() drive micros()): sleep until
+// REPLAY_SPIN_US before the frame is due, then spin the rest, since sleep_for() can overshoot by a
+// scheduler tick but spinning the whole gap would burn a core for nothing.
+//---------------------------------------------------------------------------------------------------------
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#endif
+
+#ifndef REPLAY_SPIN_US
+#ifdef _WIN32
+#define REPLAY_SPIN_US 2000 // Windows sleeps in ~1 ms ticks (at best)
+#else
+#define REPLAY_SPIN_US 200
+#endif
+#endif
+#define REPLAY_AFAP 0.0f // speed value for "as fast as possible"
+#define REPLAY_LINE_LEN 256
+#define REPLAY_ERR_BUCKETS 1024 // pacing error histogram, 1 us per bucket, the last one collects everything above
+#define REPLAY_SINK_RETRY_LIMIT 1000000
+
+typedef void (*replay_sink_fn)(void* ctx, const can_raw_frame_ts* frame);
+
+typedef struct replay_t
+{
+  can_raw_frame_ts* frames;  // timestamps in us relative to the first frame of the log
+  uint32_t numFrames;
+  uint32_t capacity;
+  uint32_t numSkipped;       // lines that weren't a classic extended data frame (RTR, FD, 11-bit, junk)
+  std::atomic<bool> stopRequested;
+} replay_ts;
+
+typedef struct replay_stats_t
+{
+  uint64_t framesSent;
+  uint64_t durationUs;
+  uint64_t sumErrUs;
+  uint64_t maxErrUs;
+  uint64_t numLate;         // frames sent more than REPLAY_SPIN_US after they were due (the sleep overshot)
+  uint32_t errHist[REPLAY_ERR_BUCKETS];
+} replay_stats_ts;
+
+// spin-wait hint: lets the sibling hyperthread run and saves power while we busy-wait
+void ReplayCpuRelax()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_pause(); // <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+int HexNibble(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+/**
+ * @brief Parses one candump -l line into a frame. Only extended (29-bit) classic data frames are taken,
+ *			that's all J1939 uses.
+ *
+ * @param *line "(sec.usec) iface IIIIIIII#DDDDDDDDDDDDDDDD"
+ * @param *frame output, timestamp = absolute log time in us
+ * @return 0 on success, -1 if the line isn't a frame we replay
+ */
+int ReplayParseLine(const char* line, can_raw_frame_ts* frame)
+{
+  unsigned long long sec;
+  unsigned long usec;
+  int consumed = 0;
+  if (sscanf(line, " (%llu.%lu) %*s %n", &sec, &usec, &consumed) != 2 || consumed == 0)
+    return -1;
+  const char* p = line + consumed;
+  uint32_t id = 0;
+  int digits = 0;
+  int nibble;
+  while ((nibble = HexNibble(*p)) >= 0)
+  {
+    id = (id << 4) | (uint32_t)nibble;
+    digits++;
+    p++;
+  }
+  if (digits != 8 || *p != '#' || p[1] == '#' || p[1] == 'R' || id > MASK_ID_29BIT)
+    return -1;
+  p++;
+  memset(frame, 0, sizeof(*frame));
+  while (frame->len < 8)
+  {
+    int hi = HexNibble(p[0]);
+    int lo = (hi < 0) ? -1 : HexNibble(p[1]);
+    if (lo < 0)
+      break;
+    frame->data[frame->len++] = (uint8_t)((hi << 4) | lo);
+    p += 2;
+  }
+  frame->id = id;
+  frame->timestamp = (uint64_t)sec * 1000000 + usec;
+  return 0;
+}
+
+void ReplayInit(replay_ts* replay)
+{
+  replay->frames = NULL;
+  replay->numFrames = 0;
+  replay->capacity = 0;
+  replay->numSkipped = 0;
+  replay->stopRequested.store(false, std::memory_order_relaxed);
+}
+
+int ReplayAddFrame(replay_ts* replay, const can_raw_frame_ts* frame)
+{
+  if (replay->numFrames == replay->capacity)
+  {
+    uint32_t newCapacity = (replay->capacity == 0) ? 4096 : replay->capacity * 2;
+    can_raw_frame_ts* frames = new (std::nothrow) can_raw_frame_ts[newCapacity];
+    if (frames == NULL)
+      return -1;
+    if (replay->numFrames > 0)
+      memcpy(frames, replay->frames, (size_t)replay->numFrames * sizeof(can_raw_frame_ts));
+    delete[] replay->frames;
+    replay->frames = frames;
+    replay->capacity = newCapacity;
+  }
+  replay->frames[replay->numFrames++] = *frame;
+  return 0;
+}
+
+// loads a whole candump -l file. Timestamps get rebased to the first frame. -1 if the file can't be read
+int ReplayLoad(replay_ts* replay, const char* path)
+{
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+    return -1;
+  char line[REPLAY_LINE_LEN];
+  can_raw_frame_ts frame;
+  int result = 0;
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    if (ReplayParseLine(line, &frame) != 0)
+    {
+      replay->numSkipped++;
+      continue;
+    }
+    if (ReplayAddFrame(replay, &frame) != 0)
+    {
+      result = -1;
+      break;
+    }
+  }
+  fclose(file);
+  uint32_t i;
+  uint64_t first = (replay->numFrames > 0) ? replay->frames[0].timestamp : 0;
+  for (i = 0; i < replay->numFrames; i++)
+    replay->frames[i].timestamp = (replay->frames[i].timestamp > first) ? replay->frames[i].timestamp - first : 0; // logs from several interfaces can be slightly out of order
+  return result;
+}
+
+void ReplayFree(replay_ts* replay)
+{
+  delete[] replay->frames;
+  ReplayInit(replay);
+}
+
+// call from any thread, ReplayRun() returns after the current frame
+void ReplayStop(replay_ts* replay)
+{
+  replay->stopRequested.store(true, std::memory_order_relaxed);
+}
+
+// sleeps most of the way to targetUs (wallNanos() / 1000) and spins the rest. Returns the wall time in us
+// at the moment it returned. Not micros(): a virtual time source doesn't move while we wait here
+uint64_t ReplayWaitUntil(uint64_t targetUs)
+{
+  uint64_t now = wallNanos() / 1000ull;
+  if (targetUs > now + REPLAY_SPIN_US)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(targetUs - now - REPLAY_SPIN_US));
+    now = wallNanos() / 1000ull;
+  }
+  while (now < targetUs)
+  {
+    ReplayCpuRelax();
+    now = wallNanos() / 1000ull;
+  }
+  return now;
+}
+
+/**
+ * @brief Plays the loaded frames into a sink.
+ *
+ * @param speed 1.0 = recorded timing, 10.0 = ten times faster, REPLAY_AFAP = no pacing at all
+ * @param loops how many times to play the log (0 is treated as 1)
+ * @param sink called once per frame, on this thread. Paced frames carry the micros() time they were sent,
+ *			AFAP frames keep the recorded time (offset by loop) so timeouts still see the original spacing
+ * @param *stats pacing error statistics, may be NULL
+ * @return number of frames sent
+ */
+uint64_t ReplayRun(replay_ts* replay, float speed, uint32_t loops, replay_sink_fn sink, void* ctx, replay_stats_ts* stats)
+{
+  if (stats != NULL)
+    memset(stats, 0, sizeof(*stats));
+  if (replay->numFrames == 0)
+    return 0;
+  if (loops == 0)
+    loops = 1;
+  bool paced = (speed > REPLAY_AFAP);
+  uint64_t logLength = replay->frames[replay->numFrames - 1].timestamp + 1;
+  uint64_t start = wallNanos() / 1000ull;
+  uint64_t sent = 0;
+  can_raw_frame_ts frame;
+  uint32_t loop;
+  uint32_t i;
+  for (loop = 0; loop < loops; loop++)
+  {
+    for (i = 0; i < replay->numFrames; i++)
+    {
+      if (replay->stopRequested.load(std::memory_order_relaxed))
+        goto done;
+      frame = replay->frames[i];
+      uint64_t logTime = (uint64_t)loop * logLength + frame.timestamp;
+      if (paced)
+      {
+        uint64_t due = start + (uint64_t)((double)logTime / speed);
+        uint64_t now = ReplayWaitUntil(due);
+        frame.timestamp = micros();
+        if (stats != NULL)
+        {
+          uint64_t err = now - due;
+          stats->sumErrUs += err;
+          stats->maxErrUs = (err > stats->maxErrUs) ? err : stats->maxErrUs;
+          stats->numLate += (err > REPLAY_SPIN_US);
+          stats->errHist[(err < REPLAY_ERR_BUCKETS) ? err : REPLAY_ERR_BUCKETS - 1]++;
+        }
+      }
+      else
+        frame.timestamp = logTime;
+      sink(ctx, &frame);
+      sent++;
+    }
+  }
+done:
+  if (stats != NULL)
+  {
+    stats->framesSent = sent;
+    stats->durationUs = wallNanos() / 1000ull - start;
+  }
+  return sent;
+}
+
+// pacing error below which `percent` % of the frames were sent, in us
+uint32_t ReplayErrPercentile(const replay_stats_ts* stats, float percent)
+{
+  uint64_t target = (uint64_t)((double)stats->framesSent * percent / 100.0);
+  uint64_t count = 0;
+  uint32_t i;
+  for (i = 0; i < REPLAY_ERR_BUCKETS; i++)
+  {
+    count += stats->errHist[i];
+    if (count > target)
+      return i;
+  }
+  return REPLAY_ERR_BUCKETS - 1;
+}
+
+void ReplayPrintStats(FILE* out, const replay_stats_ts* stats)
+{
+  fprintf(out, "replay: %llu frames in %.3f s", (unsigned long long)stats->framesSent, stats->durationUs / 1e6);
+  if (stats->framesSent > 0 && stats->sumErrUs + stats->maxErrUs > 0)
+  {
+    fprintf(out, ", pacing error mean %.1f us, p50 %u us, p99 %u us, max %llu us, late %llu",
+      (double)stats->sumErrUs / stats->framesSent, ReplayErrPercentile(stats, 50.0f), ReplayErrPercentile(stats, 99.0f),
+      (unsigned long long)stats->maxErrUs, (unsigned long long)stats->numLate);
+  }
+  fprintf(out, "\n");
+}
+
+// sink for the decode pipeline. The replay thread acts as rx thread `rxIndex`; a full ring is retried
+// for a while (the worker is behind) before the frame is counted as dropped
+typedef struct replay_pipeline_sink_t
+{
+  decode_pipeline_ts* pipe;
+  uint8_t rxIndex;
+  uint64_t dropped;
+} replay_pipeline_sink_ts;
+
+void ReplaySinkPipeline(void* ctx, const can_raw_frame_ts* frame)
+{
+  replay_pipeline_sink_ts* sink = (replay_pipeline_sink_ts*)ctx;
+  uint32_t retry;
+  for (retry = 0; retry < REPLAY_SINK_RETRY_LIMIT; retry++)
+  {
+    if (PipelinePush(sink->pipe, sink->rxIndex, frame))
+      return;
+    ReplayCpuRelax();
+  }
+  sink->dropped++;
+}
+
+#ifdef __linux__
+// opens a raw SocketCAN socket on e.g. "vcan0" for ReplaySinkSocketCan(). Returns the fd or -1
+int ReplayOpenSocketCan(const char* ifname)
+{
+  int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (fd < 0)
+    return -1;
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+  struct sockaddr_can addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.can_family = AF_CAN;
+  if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0 || (addr.can_ifindex = ifr.ifr_ifindex, bind(fd, (struct sockaddr*)&addr, sizeof(addr))) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// ctx = pointer to the int fd. vcan never blocks; on a real interface write() blocks while the tx queue is full
+void ReplaySinkSocketCan(void* ctx, const can_raw_frame_ts* frame)
+{
+  int fd = *(int*)ctx;
+  struct can_frame out;
+  memset(&out, 0, sizeof(out));
+  out.can_id = frame->id | CAN_EFF_FLAG;
+  out.can_dlc = frame->len;
+  memcpy(out.data, frame->data, frame->len);
+  if (write(fd, &out, sizeof(out)) != (ssize_t)sizeof(out))
+    perror("replay: SocketCAN write");
+}
+#endif
+
+//---------------------------------------------------------------------------------------------------------
+// END-TO-END PROTECTION (ALIVE COUNTER + CRC-8)
+// Checks the alive counter and the CRC-8 (SAE J1850: poly 0x1D, init 0xFF, xorout 0xFF) of protected
+// messages as they are decoded, and reports failures as DTCs. The CRC covers the optional 16-bit data ID
+// (low byte first, E2E profile 1 style) and every payload byte except the CRC byte itself.
+// The CRC isn't computed byte after byte: the register update is linear, so byte i of an n byte message
+// contributes L^(n-i)(byte) to the result, L being one table step. With a table per power of L the
+// lookups don't depend on each other and run in parallel. Init value and data ID are the same for every
+// frame, so their part is folded into one constant by E2EInit(), leaving 8 independent lookups per frame.
+//---------------------------------------------------------------------------------------------------------
+#define CRC8_J1850_POLY 0x1D
+#define CRC8_J1850_INIT 0xFF
+#define CRC8_J1850_XOROUT 0xFF
+#define E2E_MAX_CRC_BYTES 10 // 2 data ID bytes + 8 payload bytes
+#define CRC8_ZERO_SLICE E2E_MAX_CRC_BYTES // all zero, for bytes that aren't part of the CRC
+
+typedef struct crc8_slices_t
+{
+  uint8_t table[E2E_MAX_CRC_BYTES + 1][256]; // table[k][x] = x pushed through k + 1 table steps
+} crc8_slices_ts;
+
+constexpr crc8_slices_ts Crc8MakeSlices(uint8_t poly)
+{
+  crc8_slices_ts slices = {};
+  int x;
+  for (x = 0; x < 256; x++)
+  {
+    uint8_t crc = (uint8_t)x;
+    int bit;
+    for (bit = 0; bit < BITS_PER_BYTE; bit++)
+    {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ poly) : (uint8_t)(crc << 1);
+    }
+    slices.table[0][x] = crc;
+  }
+  int k;
+  for (k = 1; k < E2E_MAX_CRC_BYTES; k++)
+  {
+    for (x = 0; x < 256; x++)
+    {
+      slices.table[k][x] = slices.table[0][slices.table[k - 1][x]];
+    }
+  }
+  return slices;
+}
+
+constexpr crc8_slices_ts CRC8_J1850 = Crc8MakeSlices(CRC8_J1850_POLY);
+
+// plain byte by byte CRC-8 SAE J1850, the reference for Crc8J1850Sliced()
+uint8_t Crc8J1850(const uint8_t* data, uint32_t len)
+{
+  uint8_t crc = CRC8_J1850_INIT;
+  uint32_t i;
+  for (i = 0; i < len; i++)
+  {
+    crc = CRC8_J1850.table[0][crc ^ data[i]];
+  }
+  return crc ^ CRC8_J1850_XOROUT;
+}
+
+// same result for up to E2E_MAX_CRC_BYTES bytes, with independent lookups
+uint8_t Crc8J1850Sliced(const uint8_t* data, uint32_t len)
+{
+  uint8_t crc = CRC8_J1850.table[len - 1][CRC8_J1850_INIT ^ data[0]];
+  uint32_t i;
+  for (i = 1; i < len; i++)
+  {
+    crc ^= CRC8_J1850.table[len - 1 - i][data[i]];
+  }
+  return crc ^ CRC8_J1850_XOROUT;
+}
+
+typedef enum
+{
+  E2E_OK = 0,
+  E2E_ERR_COUNTER_REPEATED = 1 << 0, // same counter as the last frame (sender stuck or frame repeated)
+  E2E_ERR_COUNTER_JUMP = 1 << 1,     // more than maxDeltaCounter, frames were lost
+  E2E_ERR_CRC = 1 << 2
+} e2e_result;
+
+typedef struct e2e_config_t
+{
+  bit_field_ts counterField;
+  uint8_t crcByte;          // payload byte holding the CRC, 0-based
+  uint8_t payloadLen;
+  uint8_t crcSlice[BYTES_PER_PAYLOAD]; // table row per payload byte, CRC8_ZERO_SLICE for the CRC byte
+  uint8_t crcConst;         // init, data ID and xorout part of the CRC
+  uint8_t maxDeltaCounter;  // 1 = every frame has to arrive
+  bool useDataId;
+  uint16_t dataId;
+  int16_t counterDtc;       // DTC_Codes, -1 = don't report
+  int16_t crcDtc;
+} e2e_config_ts;
+
+typedef struct e2e_state_t
+{
+  uint8_t lastCounter;
+  bool primed;              // false until the first frame with a good CRC
+  uint32_t numOk;
+  uint32_t numCounterErrors;
+  uint32_t numCrcErrors;
+} e2e_state_ts;
+
+/**
+ * @brief Sets up the check for one message definition.
+ *
+ * @param *messageData the protected message
+ * @param counterSpn spn index of the alive counter
+ * @param crcSpn spn index of the CRC, has to be one whole Intel byte
+ * @param dataId mixed into the CRC when useDataId is set
+ * @return 0 on success, -1 if the counter or CRC SPN doesn't fit
+ */
+int E2EInit(e2e_config_ts* cfg, const can_isobus_info* messageData, uint8_t counterSpn, uint8_t crcSpn, bool useDataId, uint16_t dataId, uint8_t maxDeltaCounter)
+{
+  const spn_info* crc = &messageData->spns[crcSpn];
+  if (messageData->spns[counterSpn].len > BITS_PER_BYTE || BitFieldFromSpn(&messageData->spns[counterSpn], messageData->lenMax, &cfg->counterField) != 0)
+    return -1;
+  if (crc->len != BITS_PER_BYTE || crc->bit != 1 || crc->byte == 0 || crc->byte > messageData->lenMax || crc->byteOrder != BYTE_ORDER_INTEL
+    || messageData->lenMax > BYTES_PER_PAYLOAD || maxDeltaCounter == 0)
+    return -1;
+  cfg->crcByte = crc->byte - 1; // These values start from 1, not 0
+  cfg->payloadLen = (uint8_t)messageData->lenMax;
+  cfg->maxDeltaCounter = maxDeltaCounter;
+  cfg->useDataId = useDataId;
+  cfg->dataId = dataId;
+  cfg->counterDtc = DFC_E2EAliveCtr;
+  cfg->crcDtc = DFC_E2ECrc;
+  uint8_t numBytes = (useDataId ? 2 : 0) + cfg->payloadLen - 1;
+  uint8_t pos = 0;
+  cfg->crcConst = CRC8_J1850.table[numBytes - 1][CRC8_J1850_INIT] ^ CRC8_J1850_XOROUT;
+  if (useDataId)
+  {
+    cfg->crcConst ^= CRC8_J1850.table[numBytes - 1][dataId & MASK_8LSB] ^ CRC8_J1850.table[numBytes - 2][dataId >> SHIFT_8b];
+    pos = 2;
+  }
+  int i;
+  for (i = 0; i < BYTES_PER_PAYLOAD; i++)
+  {
+    cfg->crcSlice[i] = (i == cfg->crcByte || i >= cfg->payloadLen) ? CRC8_ZERO_SLICE : numBytes - 1 - pos++;
+  }
+  return 0;
+}
+
+// MM7 TX1/TX2/TX3: 4-bit counter in byte 7, CRC in byte 8
+int E2EInitMm7(e2e_config_ts* cfg, const can_isobus_info* messageData)
+{
+  return E2EInit(cfg, messageData, MM7_TX2_MSG_CNT, MM7_TX2_CRC, false, 0, 1);
+}
+
+void E2EResetState(e2e_state_ts* state)
+{
+  memset(state, 0, sizeof(*state));
+}
+
+uint8_t E2ECrc(const e2e_config_ts* cfg, const uint8_t data[8])
+{
+  uint8_t crc = cfg->crcConst;
+  int i;
+  for (i = 0; i < BYTES_PER_PAYLOAD; i++)
+  {
+    crc ^= CRC8_J1850.table[cfg->crcSlice[i]][data[i]];
+  }
+  return crc;
+}
+
+/**
+ * @brief Checks one received frame and reports failures as DTCs.
+ *
+ * @param *state per sender, updated
+ * @param data received payload
+ * @return E2E_OK or a combination of e2e_result bits. Don't use the frame's data unless E2E_OK.
+ */
+int E2ECheck(const e2e_config_ts* cfg, e2e_state_ts* state, const uint8_t data[8])
+{
+  if (E2ECrc(cfg, data) != data[cfg->crcByte])
+  {
+    state->numCrcErrors++;
+    if (cfg->crcDtc >= 0)
+      ReportDTC(cfg->crcDtc);
+    return E2E_ERR_CRC; // the counter of a corrupted frame means nothing
+  }
+  uint8_t counter = (uint8_t)BitFieldExtract(&cfg->counterField, LoadPayload64(data));
+  uint8_t delta = (uint8_t)((counter - state->lastCounter) & cfg->counterField.mask);
+  int result = E2E_OK;
+  if (state->primed)
+  {
+    if (delta == 0)
+      result = E2E_ERR_COUNTER_REPEATED;
+    else if (delta > cfg->maxDeltaCounter)
+      result = E2E_ERR_COUNTER_JUMP;
+  }
+  state->lastCounter = counter;
+  state->primed = true; // resync on the new counter either way, so one lost frame is one error and not all following ones
+  if (result != E2E_OK)
+  {
+    state->numCounterErrors++;
+    if (cfg->counterDtc >= 0)
+      ReportDTC(cfg->counterDtc);
+  }
+  else
+    state->numOk++;
+  return result;
+}
+
+// transmit side: writes the next counter value and the CRC into messageData->data
+int E2EProtect(const e2e_config_ts* cfg, can_isobus_info* messageData, uint8_t* counter)
+{
+  *counter = (uint8_t)((*counter + 1) & cfg->counterField.mask);
+  StorePayload64(messageData->data, BitFieldInsert(&cfg->counterField, LoadPayload64(messageData->data), *counter));
+  messageData->data[cfg->crcByte] = E2ECrc(cfg, messageData->data);
+  return 0;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// IMU ATTITUDE ESTIMATOR
+// Complementary filter turning MM7 rates + accelerations into roll/pitch, for many sensors at once.
+// State is kept per field (structure of arrays) so one instance is a few floats, not a struct with padding.
+// Frames are processed in batches: pass 1 decodes them through precompiled bit-field descriptors, pass 2
+// computes the accelerometer tilt of every step (invSqrt, fsc_atan2f, fsc_asinf) in one straight loop over
+// batch arrays, and pass 3 blends gyro and tilt per step in arrival order, which is the only part that
+// depends on the previous output. A step runs on every TX2 frame (the roll rate), with the latest TX1/TX3
+// values of that instance; without TX1/TX3 it assumes level (ay = 0, az = 1 g) and only pitch is observable.
+// Every frame goes through the E2E check first, frames failing it are dropped.
+// Accelerations only need their direction, the filter normalizes them.
+//---------------------------------------------------------------------------------------------------------
+#define ATT_BATCH 64
+#define ATT_DEFAULT_TAU_S 0.5f   // gyro/accel crossover: gyro is trusted for motion faster than this
+#define ATT_MAX_DT_S 0.5f        // a gap longer than this restarts the instance from the accelerometer
+#define ATT_DEG_TO_RAD ((float)PI / 180.0f)
+#define MM7_STAT_OK 0
+
+typedef enum
+{
+  MM7_MSG_TX1, // yaw rate, ay
+  MM7_MSG_TX2, // roll rate, ax
+  MM7_MSG_TX3, // pitch rate, az
+  NUM_MM7_MSGS
+} mm7_msg;
+
+typedef struct mm7_frame_t
+{
+  uint64_t timestamp; // us
+  uint16_t instance;  // which sensor, 0..numInstances-1 (the caller maps source address/ID to this)
+  uint8_t msg;        // mm7_msg
+  uint8_t data[8];
+} mm7_frame_ts;
+
+typedef struct attitude_output_t
+{
+  uint64_t timestamp;
+  uint16_t instance;
+  bool accelUsed;  // false = gyro only step (accel status bad or not plausible)
+  float roll;      // rad
+  float pitch;     // rad
+} attitude_output_ts;
+
+typedef struct attitude_estimator_t
+{
+  uint32_t numInstances;
+  float tau;
+  bit_field_ts fields[NUM_MM7_MSGS][MM7_TX2_NUM]; // all three messages have the TX2 layout
+  e2e_config_ts e2e[NUM_MM7_MSGS];
+  float rateScale;   // deg/s per count -> rad/s per count
+  float accelScale;
+  float rateBias;    // physical offsets, so a value is raw * scale + bias
+  float accelBias;
+  // per instance, SoA
+  float* roll;
+  float* pitch;
+  float* pitchRate;  // rad/s, from TX3
+  float* ay;         // from TX1
+  float* az;         // from TX3
+  bool* ayOk;
+  bool* azOk;
+  uint64_t* lastStep;
+  bool* primed;
+  e2e_state_ts* e2eState; // [instance * NUM_MM7_MSGS + msg]
+} attitude_estimator_ts;
+
+/**
+ * @brief Allocates the per-instance state and compiles the MM7 field descriptors.
+ *
+ * @param numInstances number of sensors
+ * @param tau filter time constant in seconds, 0 = ATT_DEFAULT_TAU_S
+ * @return 0 on success, -1 on allocation or descriptor failure
+ */
+int AttitudeInit(attitude_estimator_ts* est, uint32_t numInstances, float tau)
+{
+  const can_isobus_info* infos[NUM_MM7_MSGS] = {&INFO_MM7_A_TX1, &INFO_MM7_A_TX2, &INFO_MM7_A_TX3};
+  int m;
+  for (m = 0; m < NUM_MM7_MSGS; m++)
+  {
+    if (BitFieldCompileMessage(infos[m], est->fields[m]) != MM7_TX2_NUM || E2EInitMm7(&est->e2e[m], infos[m]) != 0)
+      return -1;
+  }
+  est->numInstances = numInstances;
+  est->tau = (tau > 0.0f) ? tau : ATT_DEFAULT_TAU_S;
+  est->rateScale = INFO_MM7_A_TX2.spns[MM7_TX2_ROLL_RATE].scaling * ATT_DEG_TO_RAD;
+  est->rateBias = SpnPhysicalOffset(&INFO_MM7_A_TX2.spns[MM7_TX2_ROLL_RATE]) * ATT_DEG_TO_RAD;
+  est->accelScale = INFO_MM7_A_TX2.spns[MM7_TX2_AX].scaling;
+  est->accelBias = SpnPhysicalOffset(&INFO_MM7_A_TX2.spns[MM7_TX2_AX]);
+  est->roll = new (std::nothrow) float[numInstances]();
+  est->pitch = new (std::nothrow) float[numInstances]();
+  est->pitchRate = new (std::nothrow) float[numInstances]();
+  est->ay = new (std::nothrow) float[numInstances]();
+  est->az = new (std::nothrow) float[numInstances]();
+  est->ayOk = new (std::nothrow) bool[numInstances]();
+  est->azOk = new (std::nothrow) bool[numInstances]();
+  est->lastStep = new (std::nothrow) uint64_t[numInstances]();
+  est->primed = new (std::nothrow) bool[numInstances]();
+  est->e2eState = new (std::nothrow) e2e_state_ts[(size_t)numInstances * NUM_MM7_MSGS](); // value-initialized: all zero = not primed
+  if (est->e2eState == NULL || est->roll == NULL || est->pitch == NULL || est->pitchRate == NULL || est->ay == NULL || est->az == NULL
+    || est->ayOk == NULL || est->azOk == NULL || est->lastStep == NULL || est->primed == NULL)
+    return -1;
+  return 0;
+}
+
+void AttitudeFree(attitude_estimator_ts* est)
+{
+  delete[] est->roll;
+  delete[] est->pitch;
+  delete[] est->pitchRate;
+  delete[] est->ay;
+  delete[] est->az;
+  delete[] est->ayOk;
+  delete[] est->azOk;
+  delete[] est->lastStep;
+  delete[] est->primed;
+  delete[] est->e2eState;
+  est->numInstances = 0;
+}
+
+/**
+ * @brief Runs a batch of MM7 frames through the filter.
+ *
+ * @param frames[] in arrival order, any mix of instances and messages
+ * @param out[] one entry per TX2 frame, needs room for numFrames
+ * @return number of outputs written
+ */
+uint32_t AttitudeProcess(attitude_estimator_ts* est, const mm7_frame_ts frames[], uint32_t numFrames, attitude_output_ts out[])
+{
+  // batch arrays for pass 2/3
+  float gx[ATT_BATCH];
+  float gy[ATT_BATCH];
+  float ax[ATT_BATCH];
+  float ay[ATT_BATCH];
+  float az[ATT_BATCH];
+  float rollAcc[ATT_BATCH];
+  float pitchAcc[ATT_BATCH];
+  bool accelOk[ATT_BATCH];
+  uint32_t frameOf[ATT_BATCH];
+  uint32_t numOut = 0;
+  uint32_t first = 0;
+  while (first < numFrames)
+  {
+    // pass 1: decode, latch TX1/TX3 values, queue a step per TX2
+    uint32_t numSteps = 0;
+    uint32_t f;
+    for (f = first; f < numFrames && numSteps < ATT_BATCH; f++)
+    {
+      const mm7_frame_ts* frame = &frames[f];
+      if (frame->instance >= est->numInstances || frame->msg >= NUM_MM7_MSGS
+        || E2ECheck(&est->e2e[frame->msg], &est->e2eState[frame->instance * NUM_MM7_MSGS + frame->msg], frame->data) != E2E_OK)
+        continue;
+      const bit_field_ts* fields = est->fields[frame->msg];
+      uint64_t payload = LoadPayload64(frame->data);
+      float rate = (float)BitFieldExtract(&fields[MM7_TX2_ROLL_RATE], payload) * est->rateScale + est->rateBias;
+      float accel = (float)BitFieldExtract(&fields[MM7_TX2_AX], payload) * est->accelScale + est->accelBias;
+      bool rateOk = BitFieldExtract(&fields[MM7_TX2_ROLL_RATE_STAT], payload) == MM7_STAT_OK;
+      bool accOk = BitFieldExtract(&fields[MM7_TX2_AX_STAT], payload) == MM7_STAT_OK;
+      uint16_t inst = frame->instance;
+      switch (frame->msg)
+      {
+      case MM7_MSG_TX1:
+        est->ay[inst] = accel;
+        est->ayOk[inst] = accOk;
+        break;
+      case MM7_MSG_TX3:
+        est->pitchRate[inst] = rateOk ? rate : 0.0f;
+        est->az[inst] = accel;
+        est->azOk[inst] = accOk;
+        break;
+      default: // TX2
+        gx[numSteps] = rateOk ? rate : 0.0f;
+        gy[numSteps] = est->pitchRate[inst];
+        ax[numSteps] = accel;
+        ay[numSteps] = est->ayOk[inst] ? est->ay[inst] : 0.0f;
+        az[numSteps] = est->azOk[inst] ? est->az[inst] : 1.0f; // level, only the direction matters
+        accelOk[numSteps] = accOk;
+        frameOf[numSteps] = f;
+        numSteps++;
+        break;
+      }
+    }
+    first = f;
+
+    // pass 2: accelerometer tilt, independent per step
+    uint32_t i;
+    for (i = 0; i < numSteps; i++)
+    {
+      float normSq = ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i];
+      float invNorm = invSqrt(normSq + 1e-12f);
+      float nx = ax[i] * invNorm;
+      nx = (nx > 1.0f) ? 1.0f : ((nx < -1.0f) ? -1.0f : nx); // invSqrt is approximate, keep asin in range
+      rollAcc[i] = fsc_atan2f(ay[i], az[i]);
+      pitchAcc[i] = -fsc_asinf(nx);
+      accelOk[i] = accelOk[i] && normSq > 0.0f;
+    }
+
+    // pass 3: integrate + blend, in order since an instance can step more than once per batch
+    for (i = 0; i < numSteps; i++)
+    {
+      const mm7_frame_ts* frame = &frames[frameOf[i]];
+      uint16_t inst = frame->instance;
+      float dt = (float)(frame->timestamp - est->lastStep[inst]) * 1e-6f;
+      if (!est->primed[inst] || dt > ATT_MAX_DT_S || frame->timestamp < est->lastStep[inst])
+      {
+        est->roll[inst] = rollAcc[i];
+        est->pitch[inst] = pitchAcc[i];
+        est->primed[inst] = accelOk[i]; // stays unprimed until it gets a usable accel vector
+      }
+      else
+      {
+        float alpha = accelOk[i] ? dt / (est->tau + dt) : 0.0f; // accel weight
+        float roll = est->roll[inst] + gx[i] * dt;
+        float pitch = est->pitch[inst] + gy[i] * dt;
+        float rollErr = rollAcc[i] - roll;
+        rollErr += (rollErr > (float)PI) ? -2.0f * (float)PI : ((rollErr < -(float)PI) ? 2.0f * (float)PI : 0.0f); // upside down wraps at +-180 deg
+        est->roll[inst] = roll + alpha * rollErr;
+        est->pitch[inst] = pitch + alpha * (pitchAcc[i] - pitch);
+      }
+      est->lastStep[inst] = frame->timestamp;
+      out[numOut].timestamp = frame->timestamp;
+      out[numOut].instance = inst;
+      out[numOut].accelUsed = accelOk[i];
+      out[numOut].roll = est->roll[inst];
+      out[numOut].pitch = est->pitch[inst];
+      numOut++;
+    }
+  }
+  return numOut;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// FLEET DTC TRACKER
+// Active DTCs of every ECU the gateway hears, kept two ways: a bitset over DTC_Codes per ECU ("what's
+// active on ECU x") and an inverted bitset over ECUs per DTC ("which ECUs have DTC y"). A new DM1 is turned
+// into a bitset through the DTC index, XORed against the stored one, and only the changed bits are
+// flipped in the inverted index, so a DM1 repeating the last one costs a few word compares. Queries
+// walk or popcount the bitsets; with AVX2 the popcounts use the nibble lookup (Mula) method on 256 bits.
+// ECUs are numbered bus * 256 + source address. Not thread safe, feed it from one thread.
+//---------------------------------------------------------------------------------------------------------
+#if defined(__AVX2__) && (defined(__x86_64__) || defined(_M_X64))
+#include <immintrin.h>
+#define FLEET_AVX2 1
+#endif
+
+#ifndef FLEET_MAX_BUSES
+#define FLEET_MAX_BUSES 16
+#endif
+#define FLEET_MAX_ECUS (FLEET_MAX_BUSES * 256)
+#define BITS_PER_WORD 64
+#define WORDS_PER_AVX2 4
+#define FLEET_ROUND_WORDS(bits) ((((bits) + BITS_PER_WORD * WORDS_PER_AVX2 - 1) / (BITS_PER_WORD * WORDS_PER_AVX2)) * WORDS_PER_AVX2) // whole 256-bit vectors
+#define FLEET_DTC_WORDS FLEET_ROUND_WORDS(NUM_DTC_CODES)
+#define FLEET_ECU_WORDS FLEET_ROUND_WORDS(FLEET_MAX_ECUS)
+
+typedef struct fleet_dtc_tracker_t
+{
+  uint64_t (*ecuDtcs)[FLEET_DTC_WORDS];  // [ecu] bit = DTC_Codes index active
+  uint64_t (*dtcEcus)[FLEET_ECU_WORDS];  // [DTC_Codes] bit = ecu has it active
+  uint16_t* unknownDtcs;                 // [ecu] active DTCs that aren't in dtc_info_array
+  uint64_t updates;
+  uint64_t changedBits;
+} fleet_dtc_tracker_ts;
+
+uint8_t CountTrailingZeros64(uint64_t x) // x must not be 0
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, (unsigned long)x);
+  if ((uint32_t)x == 0)
+  {
+    _BitScanForward(&index, (unsigned long)(x >> 32));
+    index += 32;
+  }
+  return (uint8_t)index;
+#else
+  return (uint8_t)__builtin_ctzll(x);
+#endif
+}
+
+uint8_t Popcount64(uint64_t x)
+{
+#ifdef _MSC_VER
+  return (uint8_t)(__popcnt((uint32_t)x) + __popcnt((uint32_t)(x >> 32)));
+#else
+  return (uint8_t)__builtin_popcountll(x);
+#endif
+}
+
+#ifdef FLEET_AVX2
+// popcount of every 64-bit lane: look up the bit count of each nibble, then sum bytes with psadbw
+__m256i Popcount256(__m256i v)
+{
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+  __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, lowNibble));
+  __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibble));
+  return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+uint64_t HorizontalSum256(__m256i v)
+{
+  __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  return (uint64_t)_mm_cvtsi128_si64(sum) + (uint64_t)_mm_extract_epi64(sum, 1);
+}
+#endif
+
+// number of set bits, numWords has to be a multiple of WORDS_PER_AVX2
+uint32_t BitsetCount(const uint64_t* bits, uint32_t numWords)
+{
+  uint32_t i;
+#ifdef FLEET_AVX2
+  __m256i acc = _mm256_setzero_si256();
+  for (i = 0; i < numWords; i += WORDS_PER_AVX2)
+  {
+    acc = _mm256_add_epi64(acc, Popcount256(_mm256_loadu_si256((const __m256i*)&bits[i])));
+  }
+  return (uint32_t)HorizontalSum256(acc);
+#else
+  uint32_t count = 0;
+  for (i = 0; i < numWords; i++)
+  {
+    count += Popcount64(bits[i]);
+  }
+  return count;
+#endif
+}
+
+// out = a & b, returns the number of set bits in out. out may be a or b
+uint32_t BitsetAnd(const uint64_t* a, const uint64_t* b, uint64_t* out, uint32_t numWords)
+{
+  uint32_t i;
+#ifdef FLEET_AVX2
+  __m256i acc = _mm256_setzero_si256();
+  for (i = 0; i < numWords; i += WORDS_PER_AVX2)
+  {
+    __m256i both = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)&a[i]), _mm256_loadu_si256((const __m256i*)&b[i]));
+    _mm256_storeu_si256((__m256i*)&out[i], both);
+    acc = _mm256_add_epi64(acc, Popcount256(both));
+  }
+  return (uint32_t)HorizontalSum256(acc);
+#else
+  uint32_t count = 0;
+  for (i = 0; i < numWords; i++)
+  {
+    out[i] = a[i] & b[i];
+    count += Popcount64(out[i]);
+  }
+  return count;
+#endif
+}
+
+// writes the indices of the set bits, returns how many there are (may be more than maxOut)
+uint32_t BitsetToList(const uint64_t* bits, uint32_t numWords, uint16_t out[], uint32_t maxOut)
+{
+  uint32_t count = 0;
+  uint32_t i;
+  for (i = 0; i < numWords; i++)
+  {
+    uint64_t word = bits[i];
+    while (word != 0)
+    {
+      if (count < maxOut)
+        out[count] = (uint16_t)(i * BITS_PER_WORD + CountTrailingZeros64(word));
+      count++;
+      word &= word - 1;
+    }
+  }
+  return count;
+}
+
+uint16_t FleetEcu(uint8_t bus, uint8_t src)
+{
+  return (uint16_t)(bus * 256 + src);
+}
+
+int FleetInit(fleet_dtc_tracker_ts* fleet)
+{
+  fleet->ecuDtcs = new (std::nothrow) uint64_t[FLEET_MAX_ECUS][FLEET_DTC_WORDS]();
+  fleet->dtcEcus = new (std::nothrow) uint64_t[NUM_DTC_CODES][FLEET_ECU_WORDS]();
+  fleet->unknownDtcs = new (std::nothrow) uint16_t[FLEET_MAX_ECUS]();
+  fleet->updates = 0;
+  fleet->changedBits = 0;
+  return (fleet->ecuDtcs == NULL || fleet->dtcEcus == NULL || fleet->unknownDtcs == NULL) ? -1 : 0;
+}
+
+void FleetFree(fleet_dtc_tracker_ts* fleet)
+{
+  delete[] fleet->ecuDtcs;
+  delete[] fleet->dtcEcus;
+  delete[] fleet->unknownDtcs;
+  fleet->ecuDtcs = NULL;
+  fleet->dtcEcus = NULL;
+  fleet->unknownDtcs = NULL;
+}
+
+/**
+ * @brief Replaces the active DTCs of one ECU, e.g. with the list from `DmDecode()` or `ParseDTCMessages()`.
+ *
+ * @param ecu FleetEcu(bus, src)
+ * @param listDTCs everything the ECU reports active now, an empty list clears it
+ * @return number of DTCs that went active or inactive, -1 if ecu is out of range
+ */
+int FleetUpdateEcu(fleet_dtc_tracker_ts* fleet, uint16_t ecu, const rbr_isobus_dtc_ts listDTCs[], uint16_t numDTCs)
+{
+  if (ecu >= FLEET_MAX_ECUS)
+    return -1;
+  uint64_t active[FLEET_DTC_WORDS] = {0};
+  uint16_t unknown = 0;
+  int i;
+  for (i = 0; i < numDTCs; i++)
+  {
+    int16_t code = DtcIndexLookup(DtcSpn(listDTCs[i]), DtcFmi(listDTCs[i]));
+    if (code >= 0)
+      active[code / BITS_PER_WORD] |= 1ull << (code % BITS_PER_WORD);
+    else
+      unknown++;
+  }
+  fleet->unknownDtcs[ecu] = unknown;
+  fleet->updates++;
+
+  uint64_t ecuBit = 1ull << (ecu % BITS_PER_WORD);
+  uint32_t ecuWord = ecu / BITS_PER_WORD;
+  int changed = 0;
+  int w;
+  for (w = 0; w < FLEET_DTC_WORDS; w++)
+  {
+    uint64_t diff = active[w] ^ fleet->ecuDtcs[ecu][w];
+    fleet->ecuDtcs[ecu][w] = active[w];
+    while (diff != 0) // usually nothing: the same DM1 as last second
+    {
+      uint32_t code = w * BITS_PER_WORD + CountTrailingZeros64(diff);
+      fleet->dtcEcus[code][ecuWord] ^= ecuBit;
+      changed++;
+      diff &= diff - 1;
+    }
+  }
+  fleet->changedBits += changed;
+  return changed;
+}
+
+// straight from a received DM1 payload (single frame or reassembled TP message)
+int FleetUpdateFromDm1(fleet_dtc_tracker_ts* fleet, uint8_t bus, uint8_t src, const uint8_t* payload, uint16_t len)
+{
+  rbr_isobus_dtc_ts listDTCs[DM_MAX_DTCS];
+  dm_lamps_ts lamps;
+  uint16_t numDTCs;
+  if (DmDecode(payload, len, &lamps, listDTCs, DM_MAX_DTCS, &numDTCs) != 0)
+    return -1;
+  return FleetUpdateEcu(fleet, FleetEcu(bus, src), listDTCs, numDTCs);
+}
+
+/**
+ * @brief Receive path of the tracker: single frame DM1s go straight in, TP.CM / TP.DT frames go through
+ *			the reassembler (listening only, we never answer) and a reassembled DM1 goes in and is released.
+ *			TP sessions are indexed by (src, dest) only, so only feed one bus into the reassembler.
+ *
+ * @param bus the frame's bus, for FleetEcu()
+ * @param current_time millis() (or a fake time) for the TP timeouts
+ * @param *result from TpReceiveFrame(). A completed message that isn't a DM1 is left in
+ *			`result->completed` for the caller, who has to release it
+ * @return number of DTCs that went active or inactive, 0 if the frame didn't complete a DM1, -1 on a bad DM1
+ */
+int FleetReceiveFrame(fleet_dtc_tracker_ts* fleet, uint8_t bus, const j1939_frame_ts* frame, uint64_t current_time, tp_rx_result_ts* result)
+{
+  if (frame->pgn == PGN_DM1)
+  {
+    result->hasReply = false;
+    result->completed = NULL;
+    return FleetUpdateFromDm1(fleet, bus, frame->src, frame->data, frame->dlc);
+  }
+  TpReceiveFrame(frame, J1939_GLOBAL_ADDR, current_time, result);
+  tp_session_ts* session = result->completed;
+  if (session == NULL || session->pgn != PGN_DM1)
+    return 0;
+  result->completed = NULL;
+  int changed = FleetUpdateFromDm1(fleet, bus, session->src, session->data, session->size);
+  TpReleaseSession(session);
+  return changed;
+}
+
+// "which ECUs have DFC_x active": writes ECU numbers, returns how many ECUs have it (may be more than maxEcus)
+uint32_t FleetEcusWithDtc(const fleet_dtc_tracker_ts* fleet, int code, uint16_t ecus[], uint32_t maxEcus)
+{
+  if (code < 0 || code >= NUM_DTC_CODES)
+    return 0;
+  return BitsetToList(fleet->dtcEcus[code], FLEET_ECU_WORDS, ecus, maxEcus);
+}
+
+uint32_t FleetCountEcusWithDtc(const fleet_dtc_tracker_ts* fleet, int code)
+{
+  if (code < 0 || code >= NUM_DTC_CODES)
+    return 0;
+  return BitsetCount(fleet->dtcEcus[code], FLEET_ECU_WORDS);
+}
+
+// ECUs that have every one of codes[] active at the same time. Returns how many, list in ecus[]
+uint32_t FleetEcusWithAll(const fleet_dtc_tracker_ts* fleet, const int codes[], uint16_t numCodes, uint16_t ecus[], uint32_t maxEcus)
+{
+  alignas(32) uint64_t both[FLEET_ECU_WORDS];
+  if (numCodes == 0)
+    return 0;
+  int i;
+  for (i = 0; i < numCodes; i++)
+  {
+    if (codes[i] < 0 || codes[i] >= NUM_DTC_CODES)
+      return 0;
+  }
+  uint32_t count = BitsetAnd(fleet->dtcEcus[codes[0]], fleet->dtcEcus[codes[0]], both, FLEET_ECU_WORDS);
+  for (i = 1; i < numCodes && count > 0; i++)
+  {
+    count = BitsetAnd(both, fleet->dtcEcus[codes[i]], both, FLEET_ECU_WORDS);
+  }
+  if (count > 0)
+    BitsetToList(both, FLEET_ECU_WORDS, ecus, maxEcus);
+  return count;
+}
+
+// "all active DTCs on ECU x": writes DTC_Codes indices, returns how many (may be more than maxCodes)
+uint32_t FleetDtcsOfEcu(const fleet_dtc_tracker_ts* fleet, uint16_t ecu, uint16_t codes[], uint32_t maxCodes)
+{
+  if (ecu >= FLEET_MAX_ECUS)
+    return 0;
+  return BitsetToList(fleet->ecuDtcs[ecu], FLEET_DTC_WORDS, codes, maxCodes);
+}
+
+// number of ECUs with at least one active DTC
+uint32_t FleetCountFaultyEcus(const fleet_dtc_tracker_ts* fleet)
+{
+  uint32_t count = 0;
+  uint32_t ecu;
+  for (ecu = 0; ecu < FLEET_MAX_ECUS; ecu++)
+  {
+    uint64_t any = 0;
+    int w;
+    for (w = 0; w < FLEET_DTC_WORDS; w++)
+    {
+      any |= fleet->ecuDtcs[ecu][w];
+    }
+    count += (any != 0) || (fleet->unknownDtcs[ecu] != 0);
+  }
+  return count;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// COMPRESSED SPN TIME SERIES
+// Archive format for decoded SPN streams, one column (series) per SPN, cut into blocks of at most
+// TS_BLOCK_BYTES. Timestamps are stored as delta-of-delta and values as the XOR with the previous value
+// (Gorilla, Facebook 2015), both with short prefix codes, so a cyclic signal that doesn't change costs
+// 2 bits per sample and one with a little cycle jitter ~10 bits. Every block header has the time range
+// and min/max of its samples, so queries skip whole blocks without decoding them.
+//
+// timestamp dod:  '0' = same delta | '10' + 7 bits | '110' + 9 bits | '1110' + 12 bits | '1111' + 64 bits
+// value xor:      '0' = same value | '10' + bits inside the previous leading/trailing zero window
+//                 | '11' + 5 bits leading zeros + 5 bits (length - 1) + length meaningful bits
+//---------------------------------------------------------------------------------------------------------
+#define TS_BLOCK_BYTES 1024
+#define TS_MAX_SAMPLE_BITS (4 + 64 + 2 + 10 + 32) // worst case for one sample, a block is full below this
+#define TS_BLOCK_MAX_SAMPLES 0xFFFF
+#define TS_FLOAT_BITS 32
+#define TS_NO_WINDOW 0xFF
+#define TS_BLOCK_MAX_DECODED (TS_BLOCK_BYTES * BITS_PER_BYTE / 2) // every sample after the first costs >= 2 bits
+
+typedef struct ts_block_header_t
+{
+  uint64_t firstTimestamp;
+  uint64_t lastTimestamp;
+  float minValue;
+  float maxValue;
+  uint32_t spnNum;
+  uint16_t numSamples;
+  uint16_t numBytes;
+} ts_block_header_ts;
+
+typedef struct ts_block_t
+{
+  ts_block_header_ts header;
+  uint8_t data[TS_BLOCK_BYTES];
+} ts_block_ts;
+
+typedef struct ts_encoder_t
+{
+  ts_block_ts* block;
+  uint32_t numBits;
+  uint64_t acc;           // pending bits not yet written to data[], less than 8 between calls
+  uint8_t accBits;
+  uint64_t prevTimestamp;
+  int64_t prevDelta;
+  uint32_t prevValue;     // float bits
+  uint8_t prevLeading;    // xor window of the last value that used one, TS_NO_WINDOW = none yet
+  uint8_t prevTrailing;
+} ts_encoder_ts;
+
+typedef struct ts_series_t
+{
+  uint32_t spnNum;
+  ts_block_ts* blocks;
+  uint32_t numBlocks;     // including the one being written
+  uint32_t capacity;
+  uint64_t numSamples;
+  ts_encoder_ts encoder;
+} ts_series_ts;
+
+uint8_t CountLeadingZeros32(uint32_t x) // x must not be 0
+{
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse(&index, x);
+  return (uint8_t)(31 - index);
+#else
+  return (uint8_t)__builtin_clz(x);
+#endif
+}
+
+uint32_t FloatBits(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float FloatFromBits(uint32_t bits)
+{
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// MSB first. numBits <= 64
+void TsWriteBits(ts_encoder_ts* enc, uint64_t value, uint8_t numBits)
+{
+  if (numBits > 32)
+  {
+    TsWriteBits(enc, value >> 32, numBits - 32);
+    numBits = 32;
+  }
+  enc->acc = (enc->acc << numBits) | (value & (~0ull >> (BITS_PER_PAYLOAD - numBits)));
+  enc->accBits += numBits;
+  enc->numBits += numBits;
+  while (enc->accBits >= BITS_PER_BYTE)
+  {
+    enc->accBits -= BITS_PER_BYTE;
+    enc->block->data[enc->block->header.numBytes++] = (uint8_t)(enc->acc >> enc->accBits);
+  }
+}
+
+void TsEncoderStart(ts_encoder_ts* enc, ts_block_ts* block, uint32_t spnNum)
+{
+  memset(&block->header, 0, sizeof(block->header));
+  block->header.spnNum = spnNum;
+  enc->block = block;
+  enc->numBits = 0;
+  enc->acc = 0;
+  enc->accBits = 0;
+  enc->prevDelta = 0;
+  enc->prevLeading = TS_NO_WINDOW;
+  enc->prevTrailing = 0;
+}
+
+// writes out the last partial byte. The block can't take more samples afterwards
+void TsEncoderFinish(ts_encoder_ts* enc)
+{
+  if (enc->accBits > 0)
+    TsWriteBits(enc, 0, BITS_PER_BYTE - enc->accBits);
+}
+
+/**
+ * @brief Adds a sample to the encoder's block.
+ *
+ * @param timestamp has to be >= the previous one
+ * @return 0 on success, -1 if the block is full (finish it and start a new one)
+ */
+int TsEncoderAppend(ts_encoder_ts* enc, uint64_t timestamp, float value)
+{
+  ts_block_header_ts* header = &enc->block->header;
+  uint32_t bits = FloatBits(value);
+  if (header->numSamples == TS_BLOCK_MAX_SAMPLES || enc->numBits + TS_MAX_SAMPLE_BITS > BITS_PER_BYTE * TS_BLOCK_BYTES)
+    return -1;
+  if (header->numSamples == 0) // the first sample lives in the header
+  {
+    header->firstTimestamp = timestamp;
+    header->lastTimestamp = timestamp;
+    header->minValue = value;
+    header->maxValue = value;
+    header->numSamples = 1;
+    enc->prevTimestamp = timestamp;
+    enc->prevValue = bits;
+    TsWriteBits(enc, bits, TS_FLOAT_BITS);
+    return 0;
+  }
+  if (timestamp < enc->prevTimestamp)
+    return -1;
+
+  int64_t delta = (int64_t)(timestamp - enc->prevTimestamp);
+  int64_t dod = delta - enc->prevDelta;
+  if (dod == 0)
+    TsWriteBits(enc, 0x0, 1);
+  else if (dod >= -64 && dod <= 63)
+    TsWriteBits(enc, (0x2ull << 7) | (uint64_t)(dod & 0x7F), 2 + 7);
+  else if (dod >= -256 && dod <= 255)
+    TsWriteBits(enc, (0x6ull << 9) | (uint64_t)(dod & 0x1FF), 3 + 9);
+  else if (dod >= -2048 && dod <= 2047)
+    TsWriteBits(enc, (0xEull << 12) | (uint64_t)(dod & 0xFFF), 4 + 12);
+  else
+  {
+    TsWriteBits(enc, 0xF, 4);
+    TsWriteBits(enc, (uint64_t)dod, 64);
+  }
+
+  uint32_t diff = bits ^ enc->prevValue;
+  if (diff == 0)
+    TsWriteBits(enc, 0x0, 1);
+  else
+  {
+    uint8_t leading = CountLeadingZeros32(diff);
+    uint8_t trailing = CountTrailingZeros32(diff);
+    if (enc->prevLeading != TS_NO_WINDOW && leading >= enc->prevLeading && trailing >= enc->prevTrailing)
+    {
+      uint8_t length = TS_FLOAT_BITS - enc->prevLeading - enc->prevTrailing;
+      TsWriteBits(enc, 0x2, 2);
+      TsWriteBits(enc, diff >> enc->prevTrailing, length);
+    }
+    else
+    {
+      uint8_t length = TS_FLOAT_BITS - leading - trailing;
+      TsWriteBits(enc, (0x3ull << 10) | ((uint64_t)leading << 5) | (uint64_t)(length - 1), 2 + 5 + 5);
+      TsWriteBits(enc, diff >> trailing, length);
+      enc->prevLeading = leading;
+      enc->prevTrailing = trailing;
+    }
+  }
+
+  enc->prevDelta = delta;
+  enc->prevTimestamp = timestamp;
+  enc->prevValue = bits;
+  header->lastTimestamp = timestamp;
+  header->minValue = (value < header->minValue) ? value : header->minValue;
+  header->maxValue = (value > header->maxValue) ? value : header->maxValue;
+  header->numSamples++;
+  return 0;
+}
+
+typedef struct ts_bit_reader_t
+{
+  const uint8_t* data;
+  uint32_t pos;
+  uint32_t len;
+  uint64_t bits;   // left aligned
+  uint32_t avail;
+} ts_bit_reader_ts;
+
+void TsRefill(ts_bit_reader_ts* r)
+{
+  while (r->avail <= BITS_PER_PAYLOAD - BITS_PER_BYTE && r->pos < r->len)
+  {
+    r->bits |= (uint64_t)r->data[r->pos++] << (BITS_PER_PAYLOAD - BITS_PER_BYTE - r->avail);
+    r->avail += BITS_PER_BYTE;
+  }
+}
+
+// numBits 1..32. Past the end of the data it reads zeros
+uint32_t TsReadBits(ts_bit_reader_ts* r, uint8_t numBits)
+{
+  if (r->avail < numBits)
+    TsRefill(r);
+  uint32_t value = (uint32_t)(r->bits >> (BITS_PER_PAYLOAD - numBits));
+  r->bits <<= numBits;
+  r->avail = (r->avail > numBits) ? r->avail - numBits : 0;
+  return value;
+}
+
+// number of leading 1 bits, up to max, consuming them and the terminating 0 (if max wasn't reached)
+uint8_t TsReadPrefix(ts_bit_reader_ts* r, uint8_t max)
+{
+  if (r->avail < max)
+    TsRefill(r);
+  uint8_t ones = 0;
+  while (ones < max && (r->bits >> (BITS_PER_PAYLOAD - 1)) != 0)
+  {
+    r->bits <<= 1;
+    ones++;
+  }
+  uint8_t used = ones + (ones < max);
+  r->bits <<= (ones < max);
+  r->avail = (r->avail > used) ? r->avail - used : 0;
+  return ones;
+}
+
+int64_t SignExtend(uint64_t value, uint8_t numBits)
+{
+  return (int64_t)(value << (BITS_PER_PAYLOAD - numBits)) >> (BITS_PER_PAYLOAD - numBits);
+}
+
+/**
+ * @brief Decodes a whole block.
+ *
+ * @param timestamps[] at least header.numSamples entries
+ * @param values[] at least header.numSamples entries
+ * @return number of samples decoded
+ */
+uint32_t TsBlockDecode(const ts_block_ts* block, uint64_t timestamps[], float values[])
+{
+  const ts_block_header_ts* header = &block->header;
+  ts_bit_reader_ts r = {block->data, 0, header->numBytes, 0, 0};
+  if (header->numSamples == 0)
+    return 0;
+  uint64_t timestamp = header->firstTimestamp;
+  int64_t delta = 0;
+  uint32_t bits = TsReadBits(&r, TS_FLOAT_BITS);
+  uint8_t leading = 0;
+  uint8_t trailing = 0;
+  timestamps[0] = timestamp;
+  values[0] = FloatFromBits(bits);
+  uint32_t i;
+  for (i = 1; i < header->numSamples; i++)
+  {
+    if (r.avail < 2)
+      TsRefill(&r);
+    if ((r.bits >> (BITS_PER_PAYLOAD - 2)) == 0) // fast path: same delta, same value
+    {
+      r.bits <<= 2;
+      r.avail = (r.avail > 2) ? r.avail - 2 : 0;
+      timestamp += delta;
+      timestamps[i] = timestamp;
+      values[i] = values[i - 1];
+      continue;
+    }
+    int64_t dod;
+    switch (TsReadPrefix(&r, 4))
+    {
+    case 0:
+      dod = 0;
+      break;
+    case 1:
+      dod = SignExtend(TsReadBits(&r, 7), 7);
+      break;
+    case 2:
+      dod = SignExtend(TsReadBits(&r, 9), 9);
+      break;
+    case 3:
+      dod = SignExtend(TsReadBits(&r, 12), 12);
+      break;
+    default:
+      dod = (int64_t)(((uint64_t)TsReadBits(&r, 32) << 32) | TsReadBits(&r, 32));
+      break;
+    }
+    delta += dod;
+    timestamp += delta;
+    timestamps[i] = timestamp;
+
+    switch (TsReadPrefix(&r, 2))
+    {
+    case 0:
+      break;
+    case 1:
+      bits ^= TsReadBits(&r, TS_FLOAT_BITS - leading - trailing) << trailing;
+      break;
+    default:
+    {
+      uint32_t window = TsReadBits(&r, 10);
+      leading = (uint8_t)(window >> 5);
+      uint8_t length = (uint8_t)(window & MASK_5LSB) + 1;
+      trailing = TS_FLOAT_BITS - leading - length;
+      bits ^= TsReadBits(&r, length) << trailing;
+      break;
+    }
+    }
+    values[i] = FloatFromBits(bits);
+  }
+  return i;
+}
+
+// can the block have samples in [fromTime, toTime] with a value in [minValue, maxValue]? Without decoding it
+bool TsBlockMayMatch(const ts_block_header_ts* header, uint64_t fromTime, uint64_t toTime, float minValue, float maxValue)
+{
+  return header->numSamples > 0 && header->lastTimestamp >= fromTime && header->firstTimestamp <= toTime
+    && header->maxValue >= minValue && header->minValue <= maxValue;
+}
+
+int TsSeriesInit(ts_series_ts* series, uint32_t spnNum)
+{
+  series->spnNum = spnNum;
+  series->capacity = 16;
+  series->blocks = new (std::nothrow) ts_block_ts[series->capacity];
+  if (series->blocks == NULL)
+    return -1;
+  series->numBlocks = 1;
+  series->numSamples = 0;
+  TsEncoderStart(&series->encoder, &series->blocks[0], spnNum);
+  return 0;
+}
+
+void TsSeriesFree(ts_series_ts* series)
+{
+  delete[] series->blocks;
+  series->blocks = NULL;
+  series->numBlocks = 0;
+}
+
+// appends a sample, starting a new block when the current one is full. -1 on allocation failure or time going backwards
+int TsSeriesAppend(ts_series_ts* series, uint64_t timestamp, float value)
+{
+  if (TsEncoderAppend(&series->encoder, timestamp, value) == 0)
+  {
+    series->numSamples++;
+    return 0;
+  }
+  if (timestamp < series->encoder.prevTimestamp)
+    return -1;
+  TsEncoderFinish(&series->encoder);
+  if (series->numBlocks == series->capacity)
+  {
+    ts_block_ts* blocks = new (std::nothrow) ts_block_ts[series->capacity * 2];
+    if (blocks == NULL)
+      return -1;
+    memcpy(blocks, series->blocks, (size_t)series->numBlocks * sizeof(ts_block_ts));
+    delete[] series->blocks;
+    series->blocks = blocks;
+    series->capacity *= 2;
+  }
+  TsEncoderStart(&series->encoder, &series->blocks[series->numBlocks], series->spnNum);
+  series->numBlocks++;
+  if (TsEncoderAppend(&series->encoder, timestamp, value) != 0)
+    return -1;
+  series->numSamples++;
+  return 0;
+}
+
+// archives a pipeline result; integer SPNs are stored as float (exact up to 2^24)
+int TsSeriesAppendDecoded(ts_series_ts* series, const decoded_spn_ts* decoded)
+{
+  float value = (decoded->msg->spns[decoded->spnIndex].varType == TYPE_INT) ? (float)decoded->value.i : decoded->value.f;
+  return TsSeriesAppend(series, decoded->timestamp, value);
+}
+
+// compressed size, headers included
+size_t TsSeriesBytes(const ts_series_ts* series)
+{
+  size_t bytes = 0;
+  uint32_t i;
+  for (i = 0; i < series->numBlocks; i++)
+  {
+    bytes += sizeof(ts_block_header_ts) + series->blocks[i].header.numBytes;
+  }
+  return bytes;
+}
+
+/**
+ * @brief Finds the samples in [fromTime, toTime] with a value in [minValue, maxValue]. Blocks whose header
+ *			rules them out aren't decoded. Includes the block still being written.
+ *
+ * @return number of matching samples (may be more than maxSamples, only maxSamples are written)
+ */
+uint32_t TsSeriesQuery(const ts_series_ts* series, uint64_t fromTime, uint64_t toTime, float minValue, float maxValue,
+  uint64_t timestamps[], float values[], uint32_t maxSamples)
+{
+  static thread_local uint64_t blockTimes[TS_BLOCK_MAX_DECODED];
+  static thread_local float blockValues[TS_BLOCK_MAX_DECODED];
+  uint32_t count = 0;
+  uint32_t b;
+  for (b = 0; b < series->numBlocks; b++)
+  {
+    const ts_block_ts* block = &series->blocks[b];
+    if (!TsBlockMayMatch(&block->header, fromTime, toTime, minValue, maxValue))
+      continue;
+    uint32_t n;
+    if (b + 1 == series->numBlocks && series->encoder.accBits > 0)
+    {
+      ts_block_ts tail; // block being written, plus the bits still in the encoder
+      tail.header = block->header;
+      memcpy(tail.data, block->data, block->header.numBytes);
+      tail.data[tail.header.numBytes++] = (uint8_t)(series->encoder.acc << (BITS_PER_BYTE - series->encoder.accBits));
+      n = TsBlockDecode(&tail, blockTimes, blockValues);
+    }
+    else
+      n = TsBlockDecode(block, blockTimes, blockValues);
+    uint32_t i;
+    for (i = 0; i < n; i++)
+    {
+      if (blockTimes[i] < fromTime || blockTimes[i] > toTime || blockValues[i] < minValue || blockValues[i] > maxValue)
+        continue;
+      if (count < maxSamples)
+      {
+        timestamps[count] = blockTimes[i];
+        values[count] = blockValues[i];
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+//---------------------------------------------------------------------------------------------------------
+// SIGNAL GATEWAY
+// Copies SPNs from a received message into another message definition (other PGN, layout or scaling).
+// A source -> destination mapping is compiled once into a plan step. In raw terms the conversion is
+// dst = src * ratio + bias, with ratio = srcScale / dstScale and bias = (srcOffset - dstOffset) / dstScale,
+// offsets in physical units (tables with offsetInCounts are converted first).
+// Each step uses the cheapest exact form:
+//   GW_COPY    ratio 1, bias 0: the raw bits move as they are (only clamped if the destination is narrower)
+//   GW_AFFINE  ratio and bias are multiples of 2^-shift: (src * mul + add) >> shift in 64-bit integers,
+//              e.g. 0.005 -> 0.01 per bit is (src + 1) >> 1
+//   GW_FLOAT   anything else, in double
+// All three round half up and clamp to the destination's valid range. Between unsigned fields of 8+ bits,
+// J1939 "error" (0xFE..) and "not available" (0xFF..) raw values are passed on as such instead of scaled.
+// Execution goes from the RX payload straight into the destination's data[], with no physical values in
+// between. Plans are found through a (PGN, src) table hashed like the PGN routing table; several plans
+// can hang off the same source message. The chain runs through the plans themselves, so a plan can be
+// routed under one key only; compile it twice to gateway the same message from two sources.
+//---------------------------------------------------------------------------------------------------------
+#define GATEWAY_MAX_SHIFT 30
+#define GATEWAY_FIXED_EPS 1e-6 // max error of a fixed-point step over the whole source range, in destination LSBs
+#define J1939_ERR_PREFIX 0xFE
+#define J1939_NA_PREFIX 0xFF
+#define J1939_VALID_LIMIT_PREFIX 0xFB // 0xFB00..0xFDFF (16-bit) etc. are reserved, valid values end below
+
+typedef enum
+{
+  GW_COPY,
+  GW_AFFINE,
+  GW_FLOAT,
+  NUM_GW_KINDS
+} gateway_step_kind;
+
+typedef struct gateway_map_t
+{
+  uint8_t srcSpn; // index into the source's spns[]
+  uint8_t dstSpn; // index into the destination's spns[]
+} gateway_map_ts;
+
+typedef struct gateway_step_t
+{
+  bit_field_ts src;
+  bit_field_ts dst;
+  int64_t mul;        // GW_AFFINE
+  int64_t add;        // GW_AFFINE, rounding included
+  double ratio;       // GW_FLOAT
+  double bias;        // GW_FLOAT, rounding included
+  int64_t dstMin;     // valid raw range of the destination
+  int64_t dstMax;
+  uint64_t srcErr;    // with passSpecial: src raw >= srcErr is an error indicator, >= srcNa not available
+  uint64_t srcNa;
+  uint64_t dstErr;
+  uint64_t dstNa;
+  uint8_t shift;      // GW_AFFINE
+  uint8_t kind;       // gateway_step_kind
+  bool passSpecial;
+} gateway_step_ts;
+
+typedef struct gateway_plan_t
+{
+  const can_isobus_info* srcMsg;
+  can_isobus_info* dstMsg;           // executing a plan writes to dstMsg->data
+  struct gateway_plan_t* next;       // next plan fed by the same source message
+  gateway_step_ts steps[MAX_NUM_SPNS];
+  uint8_t numSteps;
+  bool routed;                       // in gatewayRoutes, next belongs to that chain
+} gateway_plan_ts;
+
+// the scaling ScaleAndOffset() applies, as the decimal number the table meant: 0.005f is 0.004999999888,
+// which would make 0.005 -> 0.01 a ratio of 0.49999999 instead of 1/2
+double GatewayEffectiveScale(const spn_info* spn)
+{
+  if (spn->varType == TYPE_INT)
+    return (double)(int)spn->scaling;
+  char text[32];
+  snprintf(text, sizeof(text), "%.7g", spn->scaling); // all the digits a float has
+  return strtod(text, NULL);
+}
+
+// SpnPhysicalOffset() in double, on the cleaned scaling
+double GatewayEffectiveOffset(const spn_info* spn, double scale)
+{
+  return spn->offsetInCounts ? (double)spn->offset * scale : (double)spn->offset;
+}
+
+void GatewayRawRange(const spn_info* spn, int64_t* rawMin, int64_t* rawMax)
+{
+  if (spn->isSigned)
+  {
+    *rawMin = -(int64_t)(1ull << (spn->len - 1));
+    *rawMax = (int64_t)((1ull << (spn->len - 1)) - 1);
+  }
+  else
+  {
+    *rawMin = 0;
+    *rawMax = (spn->len >= BITS_PER_BYTE) ? ((int64_t)J1939_VALID_LIMIT_PREFIX << (spn->len - BITS_PER_BYTE)) - 1 : (int64_t)((1ull << spn->len) - 1);
+  }
+}
+
+
+int GatewayCompileStep(const spn_info* srcSpn, uint32_t srcLen, const spn_info* dstSpn, uint32_t dstLen, gateway_step_ts* step)
+{
+  if (BitFieldFromSpn(srcSpn, srcLen, &step->src) != 0 || BitFieldFromSpn(dstSpn, dstLen, &step->dst) != 0)
+    return -1;
+  if ((!srcSpn->isSigned && srcSpn->len == BITS_PER_PAYLOAD) || (!dstSpn->isSigned && dstSpn->len == BITS_PER_PAYLOAD)) // raw values are handled as int64_t
+    return -1;
+  double srcScale = GatewayEffectiveScale(srcSpn);
+  double dstScale = GatewayEffectiveScale(dstSpn);
+  if (dstScale == 0.0)
+    return -1;
+  step->ratio = srcScale / dstScale;
+  step->bias = (GatewayEffectiveOffset(srcSpn, srcScale) - GatewayEffectiveOffset(dstSpn, dstScale)) / dstScale;
+  GatewayRawRange(dstSpn, &step->dstMin, &step->dstMax);
+  step->passSpecial = !srcSpn->isSigned && !dstSpn->isSigned && srcSpn->len >= BITS_PER_BYTE && dstSpn->len >= BITS_PER_BYTE;
+  if (step->passSpecial)
+  {
+    step->srcErr = (uint64_t)J1939_ERR_PREFIX << (srcSpn->len - BITS_PER_BYTE);
+    step->srcNa = (uint64_t)J1939_NA_PREFIX << (srcSpn->len - BITS_PER_BYTE);
+    step->dstErr = (uint64_t)J1939_ERR_PREFIX << (dstSpn->len - BITS_PER_BYTE);
+    step->dstNa = (uint64_t)J1939_NA_PREFIX << (dstSpn->len - BITS_PER_BYTE);
+  }
+
+  step->kind = GW_FLOAT;
+  uint8_t shift;
+  for (shift = 0; shift <= GATEWAY_MAX_SHIFT; shift++)
+  {
+    double mulFixed = floor(ldexp(step->ratio, shift) + 0.5);
+    double addFixed = floor(ldexp(step->bias, shift) + 0.5);
+    double maxError = fabs(ldexp(mulFixed, -shift) - step->ratio) * ldexp(1.0, srcSpn->len) + fabs(ldexp(addFixed, -shift) - step->bias);
+    if (maxError > GATEWAY_FIXED_EPS || fabs(addFixed) >= ldexp(1.0, BITS_PER_PAYLOAD - 2))
+      continue;
+    int64_t mul = (int64_t)mulFixed;
+    int64_t add = (int64_t)addFixed;
+    uint8_t mulBits = 0;
+    while (mulBits < BITS_PER_PAYLOAD && ((mul < 0) ? -mul : mul) >> mulBits)
+      mulBits++;
+    if (srcSpn->len + mulBits + 1 > BITS_PER_PAYLOAD - 2) // src * mul + add has to stay inside int64_t
+      break;
+    step->kind = (mul == 1 && add == 0 && shift == 0) ? GW_COPY : GW_AFFINE;
+    step->mul = mul;
+    step->add = add + ((shift > 0) ? (int64_t)1 << (shift - 1) : 0);
+    step->shift = shift;
+    break;
+  }
+  step->bias += 0.5; // GW_FLOAT rounds with floor()
+  return 0;
+}
+
+/**
+ * @brief Compiles signal mappings from one message definition into another.
+ *
+ * @param maps which source SPN goes into which destination SPN
+ * @return 0 on success, -1 if a mapping is out of range, a field doesn't fit or can't be converted
+ */
+int GatewayCompile(const can_isobus_info* srcMsg, can_isobus_info* dstMsg, const gateway_map_ts maps[], uint8_t numMaps, gateway_plan_ts* plan)
+{
+  if (numMaps > MAX_NUM_SPNS)
+    return -1;
+  plan->srcMsg = srcMsg;
+  plan->dstMsg = dstMsg;
+  plan->next = NULL;
+  plan->numSteps = 0;
+  plan->routed = false;
+  int i;
+  for (i = 0; i < numMaps; i++)
+  {
+    if (maps[i].srcSpn >= MAX_NUM_SPNS || maps[i].dstSpn >= MAX_NUM_SPNS || srcMsg->spns[maps[i].srcSpn].len == 0 || dstMsg->spns[maps[i].dstSpn].len == 0)
+      return -1;
+    if (GatewayCompileStep(&srcMsg->spns[maps[i].srcSpn], srcMsg->lenMax, &dstMsg->spns[maps[i].dstSpn], dstMsg->lenMax, &plan->steps[i]) != 0)
+      return -1;
+  }
+  plan->numSteps = numMaps;
+  return 0;
+}
+
+// one source raw value to its destination raw value
+uint64_t GatewayConvert(const gateway_step_ts* step, uint64_t raw)
+{
+  if (step->passSpecial && raw >= step->srcErr)
+    return (raw >= step->srcNa) ? step->dstNa : step->dstErr;
+  int64_t val;
+  switch (step->kind)
+  {
+  case GW_COPY:
+    val = (int64_t)raw;
+    break;
+  case GW_AFFINE:
+    val = ((int64_t)raw * step->mul + step->add) >> step->shift; // arithmetic shift (C++20), rounds half up for negatives too
+    break;
+  default:
+  {
+    double x = floor((double)(int64_t)raw * step->ratio + step->bias);
+    x = (x < (double)step->dstMin) ? (double)step->dstMin : (x > (double)step->dstMax) ? (double)step->dstMax : x; // clamp before converting, out of range double -> int is UB
+    return (uint64_t)(int64_t)x;
+  }
+  }
+  val = (val < step->dstMin) ? step->dstMin : (val > step->dstMax) ? step->dstMax : val;
+  return (uint64_t)val;
+}
+
+/**
+ * @brief Runs a plan: every mapped SPN from rx goes straight into plan->dstMsg->data. Destination bits
+ *			that aren't mapped keep their value.
+ *
+ * @param rx received payload, at least max(srcMsg->lenMax, 8) bytes
+ */
+void GatewayRun(const gateway_plan_ts* plan, const uint8_t rx[])
+{
+  uint8_t* tx = plan->dstMsg->data;
+  int i;
+  for (i = 0; i < plan->numSteps; i++)
+  {
+    const gateway_step_ts* step = &plan->steps[i];
+    BitFieldInsertData(&step->dst, tx, GatewayConvert(step, BitFieldExtractData(&step->src, rx)));
+  }
+}
+
+pgn_route_table_ts gatewayRoutes; // (PGN, src) -> first gateway_plan_ts, the rest chained through next
+
+void GatewayRouteClear(void)
+{
+  if (gatewayRoutes.ready)
+  {
+    uint32_t i;
+    for (i = 0; i < PGN_ROUTE_TABLE_SIZE; i++)
+    {
+      gateway_plan_ts* plan;
+      for (plan = (gateway_plan_ts*)gatewayRoutes.entries[i].value; plan != NULL; plan = plan->next)
+      {
+        plan->routed = false;
+      }
+    }
+  }
+  PgnRouteTableClear(&gatewayRoutes);
+}
+
+/**
+ * @brief Runs `plan` for every frame of its source message's PGN from `src` (PGN_ROUTE_ANY_SRC = from sources
+ *			without an entry of their own). The plan must stay alive while it is routed, and can only be
+ *			routed once: the chain of plans for a key is linked through plan->next.
+ *
+ * @return 0 on success, -1 if the table is full or the plan is already routed
+ */
+int GatewayRouteAdd(gateway_plan_ts* plan, uint8_t src)
+{
+  if (plan->routed)
+    return -1;
+  uint32_t key = PgnRouteKey(plan->srcMsg->pgn, src);
+  gateway_plan_ts* next = (gateway_plan_ts*)PgnRouteTableFind(&gatewayRoutes, key);
+  if (PgnRouteTablePut(&gatewayRoutes, key, plan, true) != 0)
+    return -1;
+  plan->next = next;
+  plan->routed = true;
+  return 0;
+}
+
+/**
+ * @brief Gateway receive path: finds the plans for a raw 29-bit ID and runs them on the payload.
+ *
+ * @param data payload, zero padded to at least 8 bytes like can_raw_frame_ts::data
+ * @param len payload length, plans whose source message is longer are skipped
+ * @param updated destination messages written, for the caller to send
+ * @return number of entries written to updated
+ */
+int GatewayProcessFrame(uint32_t id, const uint8_t data[], uint8_t len, can_isobus_info* updated[], int maxUpdated)
+{
+  gateway_plan_ts* plan = (gateway_plan_ts*)PgnRouteTableLookup(&gatewayRoutes, PgnRouteKeyFromId(id));
+  int numUpdated = 0;
+  for (; plan != NULL && numUpdated < maxUpdated; plan = plan->next)
+  {
+    if (len < plan->srcMsg->lenMax)
+      continue;
+    GatewayRun(plan, data);
+    updated[numUpdated++] = plan->dstMsg;
+  }
+  return numUpdated;
+}
+
+double timeRampScale(uint64_t startTime, uint64_t timeout, double startVal, double endVal, bool* finishedRamp)
+{
+  uint64_t now = millis(); // read once, so the end check and the scaling see the same time
+  *finishedRamp = false;
+  if (now < startTime) // if millis() is smaller than startTime, output firstVal. timerMillis() doesn't like when startTime < millis()
+  {
+    return startVal;
+  }
+  else
+  {
+    if (timerMillis(&startTime, timeout, false, now, true) || startVal == endVal) // if startVal == endVal, no need to ramp, set finishedRamp to TRUE
+    {
+      *finishedRamp = true;
+      return endVal;
+    }
+    return scale(now, startTime, startTime + timeout, startVal, endVal, true);
+  }
+}
+
+
+//---------------------------------------------------------------------------------------------------------
+// DISCRETE-EVENT SIMULATION
+// Runs timer driven code in virtual time. Events sit in a binary min-heap ordered by (time, insertion
+// order), so ties run FIFO and a run is fully deterministic. While SimRun() is active it is the time
+// source behind millis()/micros()/nanos(), and time jumps straight from one event to the next instead of
+// being waited for: code polling timerMillis()/timeRampScale() just has to say when it next needs to run.
+// Single threaded; callbacks may schedule new events and call SimStop().
+// Build with -DSIMULATION_MODE to run the main loop's ramp and an hour of cyclic MM7 traffic this way.
+//---------------------------------------------------------------------------------------------------------
+#define NS_PER_MS 1000000ull
+#define SIM_FOREVER UINT64_MAX
+
+typedef struct simulator_t simulator_ts;
+typedef void (*sim_event_fn)(simulator_ts* sim, void* ctx);
+
+typedef struct sim_event_t
+{
+  uint64_t time; // ns
+  uint64_t seq;  // tie breaker, insertion order
+  sim_event_fn fn;
+  void* ctx;
+} sim_event_ts;
+
+struct simulator_t
+{
+  uint64_t nowNs;
+  sim_event_ts* heap;
+  uint32_t numEvents;
+  uint32_t capacity;
+  uint64_t nextSeq;
+  uint64_t numProcessed;
+  bool stopRequested;
+};
+
+int SimInit(simulator_ts* sim, uint64_t startNs, uint32_t capacity)
+{
+  sim->heap = new (std::nothrow) sim_event_ts[capacity];
+  if (sim->heap == NULL)
+    return -1;
+  sim->nowNs = startNs;
+  sim->numEvents = 0;
+  sim->capacity = capacity;
+  sim->nextSeq = 0;
+  sim->numProcessed = 0;
+  sim->stopRequested = false;
+  return 0;
+}
+
+void SimFree(simulator_ts* sim)
+{
+  delete[] sim->heap;
+  sim->heap = NULL;
+  sim->numEvents = 0;
+}
+
+bool SimEventBefore(const sim_event_ts* a, const sim_event_ts* b)
+{
+  return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+// -1 if the heap is full or atNs is in the past
+int SimSchedule(simulator_ts* sim, uint64_t atNs, sim_event_fn fn, void* ctx)
+{
+  if (sim->numEvents == sim->capacity || atNs < sim->nowNs)
+    return -1;
+  sim_event_ts event = { atNs, sim->nextSeq++, fn, ctx };
+  uint32_t i = sim->numEvents++;
+  while (i > 0 && SimEventBefore(&event, &sim->heap[(i - 1) / 2])) // sift up
+  {
+    sim->heap[i] = sim->heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  sim->heap[i] = event;
+  return 0;
+}
+
+int SimScheduleMillis(simulator_ts* sim, uint64_t atMs, sim_event_fn fn, void* ctx)
+{
+  return SimSchedule(sim, atMs * NS_PER_MS, fn, ctx);
+}
+
+void SimStop(simulator_ts* sim)
+{
+  sim->stopRequested = true;
+}
+
+sim_event_ts SimPop(simulator_ts* sim)
+{
+  sim_event_ts top = sim->heap[0];
+  sim_event_ts last = sim->heap[--sim->numEvents];
+  uint32_t i = 0;
+  for (;;) // sift down
+  {
+    uint32_t child = 2 * i + 1;
+    if (child >= sim->numEvents)
+      break;
+    if (child + 1 < sim->numEvents && SimEventBefore(&sim->heap[child + 1], &sim->heap[child]))
+      child++;
+    if (!SimEventBefore(&sim->heap[child], &last))
+      break;
+    sim->heap[i] = sim->heap[child];
+    i = child;
+  }
+  sim->heap[i] = last;
+  return top;
+}
+
+uint64_t SimClockNow(void* ctx)
+{
+  return ((simulator_ts*)ctx)->nowNs;
+}
+
+/**
+ * @brief Runs events in time order until untilNs, SimStop() or no events are left. millis() and friends
+ *			return the simulated time meanwhile; the previous time source is restored afterwards.
+ *
+ * @param untilNs last time to run events at, SIM_FOREVER = no limit. The clock ends up there if reached
+ * @return number of events run
+ */
+uint64_t SimRun(simulator_ts* sim, uint64_t untilNs)
+{
+  time_source_fn prevSource = timeSource;
+  void* prevCtx = timeSourceCtx;
+  uint64_t start = sim->numProcessed;
+  setTimeSource(SimClockNow, sim);
+  sim->stopRequested = false;
+  while (!sim->stopRequested && sim->numEvents > 0 && sim->heap[0].time <= untilNs)
+  {
+    sim_event_ts event = SimPop(sim);
+    sim->nowNs = event.time;
+    event.fn(sim, event.ctx);
+    sim->numProcessed++;
+  }
+  if (!sim->stopRequested && untilNs != SIM_FOREVER && sim->nowNs < untilNs)
+    sim->nowNs = untilNs;
+  setTimeSource(prevSource, prevCtx);
+  return sim->numProcessed - start;
+}
+
+// The main loop's demo: print the ramp every 100 ms, ramp 0..5000 over 5 s starting after 1 s, stop at 6.2 s
+typedef struct ramp_scenario_t
+{
+  uint64_t prevPrintTime;
+  uint64_t printTimeout;
+  uint64_t rampStart;
+  uint64_t rampTimeout;
+  double minVal;
+  double maxVal;
+  bool finishedRamp;
+  uint64_t progStart;
+  uint64_t programTimeout;
+  uint64_t output;
+} ramp_scenario_ts;
+
+void RampScenarioInit(ramp_scenario_ts* sc, uint64_t now)
+{
+  sc->prevPrintTime = (uint64_t)-100; // print right away
+  sc->printTimeout = 100;
+  sc->rampStart = now + 1000;
+  sc->rampTimeout = 5000;
+  sc->minVal = 0;
+  sc->maxVal = 5000;
+  sc->finishedRamp = false;
+  sc->progStart = now;
+  sc->programTimeout = 6200;
+  sc->output = 0;
+}
+
+/**
+ * @brief One pass of the main loop.
+ *
+ * @param nextDeadline millis() of the next print, ramp start/end or the program timeout, whichever is first.
+ *			Nothing observable changes before then, so polling earlier is only needed in real time.
+ * @return true once the program timeout is reached
+ */
+bool RampScenarioPoll(ramp_scenario_ts* sc, uint64_t* nextDeadline)
+{
+  uint64_t now = millis();
+  sc->output = (uint64_t)timeRampScale(sc->rampStart, sc->rampTimeout, sc->minVal, sc->maxVal, &sc->finishedRamp);
+  if (timerMillis(&sc->prevPrintTime, sc->printTimeout, true, now, true))
+  {
+    printf("time: %lld, output: %llu\n", (long long)(now - sc->rampStart), (unsigned long long)sc->output);
+  }
+  uint64_t next = std::min(sc->prevPrintTime + sc->printTimeout, sc->progStart + sc->programTimeout);
+  if (now < sc->rampStart)
+    next = std::min(next, sc->rampStart);
+  else if (now < sc->rampStart + sc->rampTimeout)
+    next = std::min(next, sc->rampStart + sc->rampTimeout);
+  *nextDeadline = next;
+  return timerMillis(&sc->progStart, sc->programTimeout, false, now, true);
+}
+
+void RampScenarioEvent(simulator_ts* sim, void* ctx)
+{
+  uint64_t next;
+  if (RampScenarioPoll((ramp_scenario_ts*)ctx, &next))
+    SimStop(sim);
+  else
+    SimScheduleMillis(sim, next, RampScenarioEvent, ctx);
+}
+
+// MM7 TX1/TX2/TX3 every 10 ms with E2E, a receiver checking the 2.5 s timeouts every 100 ms, and TX2 dropping
+// out for a few seconds in the middle
+#define CYCLIC_PERIOD_MS 10
+#define CYCLIC_MONITOR_MS 100
+
+typedef struct cyclic_scenario_t cyclic_scenario_ts;
+
+typedef struct cyclic_tx_t
+{
+  cyclic_scenario_ts* sc;
+  uint8_t msg; // mm7_msg
+} cyclic_tx_ts;
+
+struct cyclic_scenario_t
+{
+  can_isobus_info msgs[NUM_MM7_MSGS];
+  e2e_config_ts e2e[NUM_MM7_MSGS];
+  e2e_state_ts e2eState[NUM_MM7_MSGS];
+  cyclic_tx_ts tx[NUM_MM7_MSGS];
+  uint8_t counter[NUM_MM7_MSGS];
+  uint64_t lastRx[NUM_MM7_MSGS]; // millis()
+  bool timedOut[NUM_MM7_MSGS];
+  uint64_t dropFrom;             // TX2 frames in [dropFrom, dropTo) ms are lost
+  uint64_t dropTo;
+  uint64_t numFrames;
+  uint64_t numTimeouts;
+  uint64_t numE2EErrors;
+};
+
+int CyclicScenarioInit(cyclic_scenario_ts* sc, uint64_t dropFrom, uint64_t dropTo)
+{
+  const can_isobus_info* defs[NUM_MM7_MSGS] = { &INFO_MM7_A_TX1, &INFO_MM7_A_TX2, &INFO_MM7_A_TX3 };
+  int i;
+  for (i = 0; i < NUM_MM7_MSGS; i++)
+  {
+    sc->msgs[i] = *defs[i];
+    memset(sc->msgs[i].data, 0, sizeof(sc->msgs[i].data));
+    if (E2EInitMm7(&sc->e2e[i], &sc->msgs[i]) != 0)
+      return -1;
+    sc->e2e[i].counterDtc = -1; // count errors here instead of raising DTCs
+    sc->e2e[i].crcDtc = -1;
+    E2EResetState(&sc->e2eState[i]);
+    sc->tx[i] = { sc, (uint8_t)i };
+    sc->counter[i] = 0;
+    sc->lastRx[i] = millis();
+    sc->timedOut[i] = false;
+  }
+  sc->dropFrom = dropFrom;
+  sc->dropTo = dropTo;
+  sc->numFrames = 0;
+  sc->numTimeouts = 0;
+  sc->numE2EErrors = 0;
+  return 0;
+}
+
+void CyclicTxEvent(simulator_ts* sim, void* ctx)
 {
-  int i;
-  for (i = 0; i < RBR_ISOBUS_DTC_LIST_SIZE_DU16; i++)
+  cyclic_tx_ts* tx = (cyclic_tx_ts*)ctx;
+  cyclic_scenario_ts* sc = tx->sc;
+  uint64_t now = millis();
+  E2EProtect(&sc->e2e[tx->msg], &sc->msgs[tx->msg], &sc->counter[tx->msg]);
+  sc->numFrames++;
+  if (!(tx->msg == MM7_MSG_TX2 && now >= sc->dropFrom && now < sc->dropTo)) // receive side
   {
-    if (encDTCs[i] != (uint16_t)(-1))
-      decDTCs[i] = dtc_info_array[encDTCs[i]];
+    if (E2ECheck(&sc->e2e[tx->msg], &sc->e2eState[tx->msg], sc->msgs[tx->msg].data) != E2E_OK)
+      sc->numE2EErrors++;
+    sc->lastRx[tx->msg] = now;
+    sc->timedOut[tx->msg] = false;
   }
+  SimScheduleMillis(sim, now + CYCLIC_PERIOD_MS, CyclicTxEvent, ctx);
 }
 
-void ParseDTCMessages(uint8_t* lamps, uint8_t encodedMessages[MAX_NUM_ENC_DTC_MSGS][MAX_NUM_BYTES_PER_DTC_MSG], uint8_t numEncodedMessages, rbr_isobus_dtc_ts listDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16], uint8_t* numDTCs)
+void CyclicMonitorEvent(simulator_ts* sim, void* ctx)
 {
-  uint16_t encDTCs[RBR_ISOBUS_DTC_LIST_SIZE_DU16];
-  uint64_t encMsg = 0;
+  cyclic_scenario_ts* sc = (cyclic_scenario_ts*)ctx;
   int i;
-  for (i = 0; i < MAX_NUM_ENC_DTC_MSGS; i++)
+  for (i = 0; i < NUM_MM7_MSGS; i++)
   {
-    encMsg = 0;
-    int j;
-    for (j = 0; j < MAX_NUM_BYTES_PER_DTC_MSG; j++)
+    if (!sc->timedOut[i] && timerMillis(&sc->lastRx[i], sc->msgs[i].timeout, false, 0, false))
     {
-      encMsg |= (uint64_t)encodedMessages[i][j] << (SHIFT_8b * j); // Converting to a 64-bit num makes parsing easier
+      sc->timedOut[i] = true;
+      sc->numTimeouts++;
     }
-    *numDTCs |= (uint64_t)(i & MASK_2LSB) << SHIFT_MSG_NUM;
-    *lamps = (encMsg >> SHIFT_DTC_LAMPS) & MASK_4LSB;
-    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 0] = (encMsg >> SHIFT_DTC_MSG_1) & MASK_10LSB;
-    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 1] = (encMsg >> SHIFT_DTC_MSG_2) & MASK_10LSB;
-    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 2] = (encMsg >> SHIFT_DTC_MSG_3) & MASK_10LSB;
-    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 3] = (encMsg >> SHIFT_DTC_MSG_4) & MASK_10LSB;
-    encDTCs[i * MAX_NUM_DTCS_PER_ENC_MSG + 4] = (encMsg >> SHIFT_DTC_MSG_5) & MASK_10LSB;
   }
-  DecodeDTCMessages(encDTCs, listDTCs);
+  SimScheduleMillis(sim, millis() + CYCLIC_MONITOR_MS, CyclicMonitorEvent, ctx);
 }
 
+int RunSimulation(void)
+{
+  simulator_ts sim;
+  if (SimInit(&sim, 0, 64) != 0)
+    return -1;
+  ramp_scenario_ts ramp;
+  RampScenarioInit(&ramp, 0);
+  SimSchedule(&sim, 0, RampScenarioEvent, &ramp);
+  uint64_t wallStart = wallNanos();
+  uint64_t numEvents = SimRun(&sim, SIM_FOREVER);
+  printf("ramp: %.1f s simulated in %.3f ms wall, %llu events\n", (double)sim.nowNs / 1e9, (double)(wallNanos() - wallStart) / 1e6, (unsigned long long)numEvents);
+  SimFree(&sim);
 
-//void SetMRFRMRelay(int byte, int bit, int spnInfoIndex, int state)
-//{
-//#define BITS_PER_BYTE 8
-//  uint8_t data[8] = { 0xFF,0xAA,0,0,0,0,0,0 };
-//#define MASK_2LSB 0x03
-//  uint8_t byteIndex = byte - 1; // These values start from 1, not 0
-//  uint8_t bitIndex = bit - 1;
-//  uint8_t mask = MASK_2LSB;
-//
-//  printf("mask1: %02X\n", mask);
-//  uint8_t shift = (BITS_PER_BYTE - bit) - 1;
-//  mask = mask << shift;
-//
-//  printf("mask2: %02X\n", mask);
-//  mask = ~mask;
-//
-//  printf("mask3: %02X\n", mask);
-//
-//  uint8_t originalVal = data[byteIndex];
-//
-//  uint8_t oldValue = data[byteIndex] & mask; // remove what we are changing from the current state
-//  uint8_t newValue = state << shift; // shift the 2-bit state into position
-//  data[byteIndex] = oldValue | newValue; // OR the new state with the masked oldValue
-//
-//  printf("byteIndex: %02X\n", byteIndex);
-//  printf("bitIndex: %02X\n", bitIndex);
-//  printf("mask: %02X\n", mask);
-//  printf("shift: %d\n", shift);
-//  printf("original val: %02X\n", originalVal);
-//  printf("masked old val: %02X\n", oldValue);
-//  printf("masked new val: %02X\n", newValue);
-//  printf("new val: %02X\n", data[byteIndex]);
-//  printf("~~~~~~~~~~~~\n");
-//}
+  static cyclic_scenario_ts cyclic;
+  const uint64_t hourMs = 3600000;
+  if (SimInit(&sim, 0, 64) != 0)
+    return -1;
+  setTimeSource(SimClockNow, &sim); // lastRx starts at simulated 0
+  int err = CyclicScenarioInit(&cyclic, hourMs / 2, hourMs / 2 + 4000);
+  setTimeSource(NULL, NULL);
+  if (err != 0)
+    return -1;
+  int i;
+  for (i = 0; i < NUM_MM7_MSGS; i++)
+  {
+    SimScheduleMillis(&sim, i, CyclicTxEvent, &cyclic.tx[i]); // spread over the cycle a bit
+  }
+  SimScheduleMillis(&sim, CYCLIC_MONITOR_MS, CyclicMonitorEvent, &cyclic);
+  wallStart = wallNanos();
+  numEvents = SimRun(&sim, hourMs * NS_PER_MS);
+  double wallMs = (double)(wallNanos() - wallStart) / 1e6;
+  printf("cyclic: 1 h simulated in %.1f ms wall (%.0fx real time), %llu events, %llu frames, %llu timeouts, %llu E2E errors\n",
+    wallMs, 3600000.0 / wallMs, (unsigned long long)numEvents, (unsigned long long)cyclic.numFrames,
+    (unsigned long long)cyclic.numTimeouts, (unsigned long long)cyclic.numE2EErrors);
+  SimFree(&sim);
+  return 0;
+}
 
-typedef enum
-{
-  TYPE_INT,
-  TYPE_FLOAT,
-  NUM_VAR_TYPES // Special value to represent the total number of DTC codes
-} var_type;
 
-typedef struct
+#ifdef BENCHMARK_MODE
+//---------------------------------------------------------------------------------------------------------
+// MICROBENCHMARKS
+// Build:  g++ -std=c++20 -O2 -DBENCHMARK_MODE Cpp_Playground/main.cpp -o cpp_playground_bench
+// Add -mavx2 to time the AVX2 paths (BitFieldExtractBatch, fleet tracker popcounts) instead of the scalar ones.
+// main() then runs every benchmark once, prints a table and writes BENCHMARK_JSON_PATH, so results can be
+// diffed between commits. Inputs are generated up front from a fixed seed (same inputs every run) and
+// the timed loops only walk those arrays. Each benchmark is repeated BENCH_REPS times, median and min reported.
+//---------------------------------------------------------------------------------------------------------
+#ifndef BENCHMARK_JSON_PATH
+#define BENCHMARK_JSON_PATH "bench_results.json"
+#endif
+#define BENCH_REPS 7
+#define BENCH_INPUTS 4096 // power of 2, inputs are cycled with i & (BENCH_INPUTS - 1)
+#define BENCH_MAX_RESULTS 64
+
+typedef struct bench_result_t
 {
-  uint32_t spnNum;
-  uint8_t byte; // we start counting this at 1 instead of 0, since non-programmers made the J1939 standard...
-  uint8_t bit;  // we start counting this at 1 instead of 0, since non-programmers made the J1939 standard...
-  uint8_t len;
-  float scaling;
-  int32_t offset;
-  var_type varType;
-} spn_info;
+  const char* name;
+  uint64_t iterations;
+  double nsPerOpMedian;
+  double nsPerOpMin;
+} bench_result_ts;
 
-#define MAX_NUM_SPNS 30
-#define BITS_PER_BYTE 8
+bench_result_ts benchResults[BENCH_MAX_RESULTS];
+uint8_t benchNumResults = 0;
+volatile uint64_t benchSink = 0;
 
-typedef struct
+void BenchConsume(uint64_t value) // keeps the compiler from throwing the benchmarked work away
 {
-  uint8_t instanceNum;
-  uint16_t boxNum;
-  uint32_t pgn;
-  uint8_t format; // BDS_CAN_STD_DU8 or BDS_CAN_EXD_DU8
-  uint8_t prio;
-  uint8_t src;
-  uint8_t dest;
-  uint16_t cycle;
-  uint16_t offset;
-  uint16_t timeout;
-  uint16_t startTimeout;
-  uint32_t lenMax;
-  uint8_t data[8];
-  spn_info spns[MAX_NUM_SPNS];
-} can_isobus_info;
+  benchSink = value;
+}
 
-int ExtractValueFromCanTelegram(can_isobus_info messageData, int spnInfoIndex, uint64_t* output)
+// sorts the per-rep samples, prints them and keeps them for the JSON file
+void BenchRecord(const char* name, uint64_t iterations, double samples[BENCH_REPS])
 {
-  uint8_t byteIndex = messageData.spns[spnInfoIndex].byte - 1;                                                              // These values start from 1, not 0
-  uint8_t bitIndex = messageData.spns[spnInfoIndex].bit - 1;                                                                // These values start from 1, not 0
-  if ((BITS_PER_BYTE * byteIndex + bitIndex + messageData.spns[spnInfoIndex].len) > (messageData.lenMax * BITS_PER_BYTE)) // Check if we are asking for something outside of telegram's allocation
-    return -1;                                                                                                            // Return FSC_ERR if we are going to overrun the array
+  std::sort(samples, samples + BENCH_REPS);
+  if (benchNumResults < BENCH_MAX_RESULTS)
+    benchResults[benchNumResults++] = { name, iterations, samples[BENCH_REPS / 2], samples[0] };
+  printf("%-36s %12llu %12.2f %12.2f %14.0f\n", name, (unsigned long long)iterations, samples[BENCH_REPS / 2], samples[0], 1e9 / samples[BENCH_REPS / 2]);
+}
 
-  uint64_t mask = 0;
-  int i = 0;
-  for (i; i < messageData.spns[spnInfoIndex].len; i++)
+template <typename F>
+void BenchRun(const char* name, uint64_t iterations, F body)
+{
+  double samples[BENCH_REPS];
+  uint64_t i;
+  for (i = 0; i < iterations / 10 + 1; i++) // warm up caches and branch predictors
   {
-    mask |= (1 << i);
+    body(i);
   }
-  uint64_t val = 0;
-  uint8_t numBytes = 1 + (bitIndex + messageData.spns[spnInfoIndex].len - 1) / BITS_PER_BYTE; // How many bytes does this information span?
-  i = 0;
-  for (i; i < numBytes; i++)
+  int rep;
+  for (rep = 0; rep < BENCH_REPS; rep++)
   {
-    val |= messageData.data[byteIndex + i] << (BITS_PER_BYTE * i);
+    uint64_t start = nanos();
+    for (i = 0; i < iterations; i++)
+    {
+      body(i);
+    }
+    samples[rep] = (double)(nanos() - start) / iterations;
   }
-  *output = (val >> bitIndex) & mask;
-  return 0;
-}
-
-void ScaleAndOffset_Float(uint64_t inRawVal, spn_info spn, float* outVal)
-{
-  *outVal = (float)(inRawVal * spn.scaling + spn.offset);
+  BenchRecord(name, iterations, samples);
 }
 
-void ScaleAndOffset_Int(uint64_t inRawVal, spn_info spn, int* outVal)
-{
-  *outVal = (int)(inRawVal * (int)spn.scaling + spn.offset);
-}
+// decode pipeline throughput: BENCH_PIPE_FRAMES frames over BENCH_PIPE_MSGS PGNs (so every shard gets its
+// share) pushed by one rx thread per 4 workers, this thread consumes all outputs. Reported per frame,
+// wall time, so with N workers on N free cores it should be ~1/N of the 1 worker figure
+#define BENCH_PIPE_MSGS 256
+#define BENCH_PIPE_FRAMES (1u << 20)
 
-void ScaleAndOffset(uint64_t inRawVal, spn_info spn, void* outVal)
+void BenchPipelineRx(decode_pipeline_ts* pipe, uint8_t rxIndex, const can_raw_frame_ts* frames, uint32_t numFrames)
 {
-  switch (spn.varType)
+  uint32_t i;
+  for (i = 0; i < numFrames; i++)
   {
-  case TYPE_INT:
-    ScaleAndOffset_Int(inRawVal, spn, (int*)outVal);
-    break;
-  case TYPE_FLOAT:
-    ScaleAndOffset_Float(inRawVal, spn, (float*)outVal);
-    break;
-  default: // do nothing for now...
-    break;
+    while (!PipelinePush(pipe, rxIndex, &frames[i & (BENCH_INPUTS - 1)]))
+      std::this_thread::yield();
   }
 }
 
-typedef enum
+void BenchPipeline(uint8_t numWorkers, const uint8_t payloads[BENCH_INPUTS][8], std::mt19937_64* rng)
 {
-  MM7_TX2_ROLL_RATE,
-  MM7_TX2_CLU_STAT,
-  MM7_TX2_ROLL_RATE_STAT,
-  MM7_TX2_CLU_DIAG,
-  MM7_TX2_AX,
-  MM7_TX2_MSG_CNT,
-  MM7_TX2_AX_STAT,
-  MM7_TX2_CRC,
-  MM7_TX2_NUM
-} PGN_MM7_TX2;
+  static can_isobus_info msgs[BENCH_PIPE_MSGS];
+  static pgn_route_table_ts routes; // its own table, pgnRoutes belongs to the application
+  static can_raw_frame_ts frames[PIPE_MAX_RX][BENCH_INPUTS];
+  static decode_pipeline_ts pipe;
+  static decoded_spn_ts out[PIPE_BATCH];
+  static char names[PIPE_MAX_WORKERS + 1][48];
+  int i, r;
+  PgnRouteTableClear(&routes);
+  for (i = 0; i < BENCH_PIPE_MSGS; i++)
+  {
+    msgs[i] = INFO_MM7_A_TX2;
+    msgs[i].pgn = 0xFF00 + i;
+    PgnRouteTablePut(&routes, PgnRouteKey(msgs[i].pgn, PGN_ROUTE_ANY_SRC), &msgs[i], false);
+  }
+  for (r = 0; r < PIPE_MAX_RX; r++)
+  {
+    for (i = 0; i < BENCH_INPUTS; i++)
+    {
+      frames[r][i].timestamp = i;
+      frames[r][i].id = J1939BuildId(6, 0xFF00 + (*rng)() % BENCH_PIPE_MSGS, 0xE2, J1939_GLOBAL_ADDR);
+      frames[r][i].len = 8;
+      memcpy(frames[r][i].data, payloads[i], 8);
+    }
+  }
 
-can_isobus_info INFO_MM7_A_TX2 = {
-    .instanceNum = 1,
-    .boxNum = 11,
-    .format = 0,
-    .cycle = 0,
-    .offset = 0,
-    .timeout = 2500,
-    .startTimeout = 5000,
-    .lenMax = 8,
-    .spns = {
-        {.spnNum = 0, .byte = 1, .bit = 1, .len = 16, .scaling = 0.005, .offset = -0x8000, .varType = TYPE_FLOAT},
-        {.spnNum = 0, .byte = 3, .bit = 1, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
-        {.spnNum = 0, .byte = 3, .bit = 5, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
-        {.spnNum = 0, .byte = 4, .bit = 1, .len = 8, .scaling = 1, .offset = 0, .varType = TYPE_INT},
-        {.spnNum = 0, .byte = 5, .bit = 1, .len = 16, .scaling = 0.00125, .offset = -0x8000, .varType = TYPE_FLOAT},
-        {.spnNum = 0, .byte = 7, .bit = 1, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
-        {.spnNum = 0, .byte = 7, .bit = 5, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT},
-        {.spnNum = 0, .byte = 8, .bit = 1, .len = 8, .scaling = 1, .offset = 0, .varType = TYPE_INT}}};
+  uint8_t numRx = (uint8_t)((numWorkers + 3) / 4);
+  if (numRx > PIPE_MAX_RX)
+    numRx = PIPE_MAX_RX;
+  uint32_t perRx = BENCH_PIPE_FRAMES / numRx;
+  double samples[BENCH_REPS];
+  int rep;
+  for (rep = 0; rep < BENCH_REPS; rep++)
+  {
+    PipelineInit(&pipe, &routes, numRx, numWorkers);
+    PipelineStart(&pipe);
+    std::thread rxThreads[PIPE_MAX_RX];
+    uint64_t start = nanos();
+    for (r = 0; r < numRx; r++)
+    {
+      rxThreads[r] = std::thread(BenchPipelineRx, &pipe, (uint8_t)r, frames[r], perRx);
+    }
+    uint64_t decoded = 0;
+    uint64_t values = 0;
+    while (decoded < (uint64_t)perRx * numRx)
+    {
+      decoded = 0;
+      int w;
+      for (w = 0; w < numWorkers; w++)
+      {
+        values += PipelinePoll(&pipe, w, out, PIPE_BATCH);
+        decoded += pipe.stats[w].frames.load(std::memory_order_relaxed);
+      }
+    }
+    samples[rep] = (double)(nanos() - start) / ((uint64_t)perRx * numRx);
+    for (r = 0; r < numRx; r++)
+    {
+      rxThreads[r].join();
+    }
+    PipelineFree(&pipe);
+    BenchConsume(values);
+  }
+  snprintf(names[numWorkers], sizeof(names[numWorkers]), "DecodePipeline (%u workers, %u rx)", numWorkers, numRx);
+  BenchRecord(names[numWorkers], (uint64_t)perRx * numRx, samples);
+}
 
-typedef enum
+int BenchWriteJson(const char* path)
 {
-  CSTM_ENG_1_SPN_247,
-  CSTM_ENG_1_SPN_249,
-  CSTM_ENG_1_SPN_NUM
-} PGN_CSTM_ENG_1_SPNS;
-can_isobus_info INFO_CSTM_ENG_1 = {
-    .instanceNum = 1,
-    .boxNum = 12,
-    .pgn = 0x200,
-    .src = 0x00,
-    .timeout = 2500,
-    .startTimeout = 5000,
-    .lenMax = 8,
-    .spns = {
-        {.spnNum = 247, .byte = 1, .bit = 1, .len = 32, .scaling = 0.05f, .offset = 0, .varType = TYPE_FLOAT},   // Engine Total Hours of Operation
-        {.spnNum = 249, .byte = 5, .bit = 1, .len = 32, .scaling = 0.05f, .offset = 0, .varType = TYPE_FLOAT}} }; // Engine Total Revolutions
-
+  FILE* out = fopen(path, "w");
+  if (out == NULL)
+    return -1;
+  fprintf(out, "{\n  \"epoch\": %lld,\n", epoch());
+#if defined(__clang__)
+  fprintf(out, "  \"compiler\": \"clang %s\",\n", __clang_version__);
+#elif defined(__GNUC__)
+  fprintf(out, "  \"compiler\": \"gcc %s\",\n", __VERSION__);
+#elif defined(_MSC_VER)
+  fprintf(out, "  \"compiler\": \"msvc %d\",\n", _MSC_VER);
+#endif
+  fprintf(out, "  \"benchmarks\": [\n");
+  int i;
+  for (i = 0; i < benchNumResults; i++)
+  {
+    fprintf(out, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op_median\": %.3f, \"ns_per_op_min\": %.3f, \"ops_per_sec\": %.0f}%s\n",
+      benchResults[i].name, (unsigned long long)benchResults[i].iterations, benchResults[i].nsPerOpMedian, benchResults[i].nsPerOpMin,
+      1e9 / benchResults[i].nsPerOpMedian, (i + 1 < benchNumResults) ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  fclose(out);
+  return 0;
+}
 
-int InsertValueToCanTelegram(can_isobus_info* messageData, int spnInfoIndex, uint64_t input)
+int RunBenchmarks(const char* jsonPath)
 {
-  uint8_t byteIndex = messageData->spns[spnInfoIndex].byte - 1;                                                               // These values start from 1, not 0
-  uint8_t bitIndex = messageData->spns[spnInfoIndex].bit - 1;                                                                 // These values start from 1, not 0
-  if ((BITS_PER_BYTE * byteIndex + bitIndex + messageData->spns[spnInfoIndex].len) > (messageData->lenMax * BITS_PER_BYTE)) // Check if we are asking for something outside of telegram's allocation
-    return -1;                                                                                                              // Return FSC_ERR if we are going to overrun the array
+  std::mt19937_64 rng(0x1939); // fixed seed: identical inputs on every run
+  static uint32_t lookupSpn[BENCH_INPUTS];
+  static uint8_t lookupFmi[BENCH_INPUTS];
+  static rbr_isobus_dtc_ts dtcLists[BENCH_INPUTS / 16][RBR_ISOBUS_DTC_LIST_SIZE_DU16];
+  static uint8_t dtcCounts[BENCH_INPUTS / 16];
+  static uint8_t payloads[BENCH_INPUTS][8];
+  static uint8_t spnIndex[BENCH_INPUTS];
+  static uint64_t rawVals[BENCH_INPUTS];
+  static double scaleIn[BENCH_INPUTS];
+  static float mathIn[BENCH_INPUTS];
+  static float mathIn2[BENCH_INPUTS];
+  int i;
 
-  uint64_t mask = 0;
-  int i = 0;
-  for (i; i < messageData->spns[spnInfoIndex].len; i++)
+  // DTC lookups: most are codes from the catalog, skewed towards the few that are active most of the time
+  // (geometric over the table), ~10% are codes we don't know
+  std::geometric_distribution<int> activeDtc(0.05);
+  for (i = 0; i < BENCH_INPUTS; i++)
   {
-    mask |= (1 << i);
+    if (rng() % 10 == 0)
+    {
+      lookupSpn[i] = 600000 + rng() % 1000;
+      lookupFmi[i] = rng() % 32;
+    }
+    else
+    {
+      int code = (int)((activeDtc(rng) * 37) % NUM_DTC_CODES); // spread the popular ones over the table, not just the front
+      lookupSpn[i] = DtcSpn(dtc_info_array[code]);
+      lookupFmi[i] = DtcFmi(dtc_info_array[code]);
+    }
   }
-  uint64_t val = 0;
-  uint8_t numBytes = 1 + (bitIndex + messageData->spns[spnInfoIndex].len - 1) / BITS_PER_BYTE; // How many bytes does this information span?
-  i = 0;
-  for (i; i < numBytes; i++)
+  // DTC lists: usually a handful active, sometimes the full 20
+  for (i = 0; i < BENCH_INPUTS / 16; i++)
   {
-    uint8_t byteMask = 0;
-    uint8_t byteInput = 0;
-    uint8_t invMask = 0;
-    int8_t byteMaskShift = messageData->spns[spnInfoIndex].len - ((BITS_PER_BYTE * (numBytes - i)) - bitIndex); // figure out how many bits to shift to convert a potential value over 8 bits into chunks of 8 bits
-    if (byteMaskShift > 0)
+    dtcCounts[i] = (rng() % 8 == 0) ? RBR_ISOBUS_DTC_LIST_SIZE_DU16 : rng() % 6;
+    uint32_t j;
+    for (j = 0; j < RBR_ISOBUS_DTC_LIST_SIZE_DU16; j++)
     {
-      byteMask = (mask >> byteMaskShift);
-      byteInput = (input >> byteMaskShift) & byteMask;
+      dtcLists[i][j] = dtc_info_array[rng() % NUM_DTC_CODES];
     }
-    else // if shift is negative, make it positive and shift left instead
+  }
+  // payloads: cyclic frames, mostly slowly changing values around a midpoint
+  for (i = 0; i < BENCH_INPUTS; i++)
+  {
+    uint64_t word = 0x7FFF00007FFF0000ull + (rng() % 512) + ((rng() % 512) << 32);
+    int b;
+    for (b = 0; b < 8; b++)
     {
-      byteMaskShift *= -1;
-      byteMask = (mask << byteMaskShift);
-      byteInput = (input << byteMaskShift) & byteMask;
+      payloads[i][b] = (word >> (8 * b)) & MASK_8LSB;
     }
-    invMask = ~byteMask;
-    messageData->data[byteIndex + i] &= invMask; // remove previous data in the location we are writing to
-    messageData->data[byteIndex + i] |= byteInput;
+    spnIndex[i] = rng() % MM7_TX2_NUM;
+    rawVals[i] = rng() & 0xFFFF;
+    scaleIn[i] = -10.0 + (double)(rng() % 12000) / 100.0; // 0..100 range, ~17% of it outside and clipped
+    mathIn[i] = -1.0f + 2.0f * (float)(rng() % 100000) / 100000.0f;
+    mathIn2[i] = 0.001f * powf(10.0f, 6.0f * (float)(rng() % 100000) / 100000.0f); // log-uniform 1e-3..1e3
   }
-  // *output = (val >> bitIndex) & mask;
-  return 0;
-}
+  uint64_t mask = BENCH_INPUTS - 1;
 
-double timeRampScale(uint64_t startTime, uint64_t timeout, double startVal, double endVal, bool* finishedRamp)
-{
-  *finishedRamp = false;
-  if (millis() < startTime) // if millis() is smaller than startTime, output firstVal. timerMillis() doesn't like when startTime < millis()
+  printf("%-36s %12s %12s %12s %14s\n", "benchmark", "iterations", "median ns", "min ns", "ops/s");
+
+  BenchRun("GetIndexOfDM1", 200000, [&](uint64_t n) {
+    BenchConsume(GetIndexOfDM1(lookupSpn[n & mask], lookupFmi[n & mask], dtc_info_array, NUM_DTC_CODES));
+  });
+  BenchRun("DtcIndexLookup", 200000, [&](uint64_t n) {
+    BenchConsume(DtcIndexLookup(lookupSpn[n & mask], lookupFmi[n & mask]));
+  });
+  BenchRun("EncodeDTCMessages", 20000, [&](uint64_t n) {
+    uint16_t enc[RBR_ISOBUS_DTC_LIST_SIZE_DU16];
+    EncodeDTCMessages(dtcLists[n & (mask >> 4)], enc);
+    BenchConsume(enc[n % RBR_ISOBUS_DTC_LIST_SIZE_DU16]);
+  });
+  BenchRun("SerializeDTCMessages", 20000, [&](uint64_t n) {
+    uint8_t enc[MAX_NUM_ENC_DTC_MSGS][MAX_NUM_BYTES_PER_DTC_MSG];
+    uint8_t numEnc;
+    SerializeDTCMessages(n & MASK_4LSB, dtcLists[n & (mask >> 4)], dtcCounts[n & (mask >> 4)], enc, &numEnc);
+    BenchConsume(enc[0][0] + numEnc);
+  });
+  BenchRun("Serialize+ParseDTCMessages", 20000, [&](uint64_t n) {
+    uint8_t enc[MAX_NUM_ENC_DTC_MSGS][MAX_NUM_BYTES_PER_DTC_MSG];
+    uint8_t numEnc;
+    uint8_t lamps;
+    uint8_t numDTCs = 0;
+    rbr_isobus_dtc_ts dec[RBR_ISOBUS_DTC_LIST_SIZE_DU16];
+    SerializeDTCMessages(n & MASK_4LSB, dtcLists[n & (mask >> 4)], dtcCounts[n & (mask >> 4)], enc, &numEnc);
+    ParseDTCMessages(&lamps, enc, numEnc, dec, &numDTCs);
+    BenchConsume(lamps + DtcFmi(dec[0]));
+  });
+  // fleet tracker: every ECU of every bus sends one of the DTC lists as DM1
+  static fleet_dtc_tracker_ts benchFleet;
+  static uint8_t dm1Payloads[BENCH_INPUTS / 16][DM_HEADER_BYTES + DM_BYTES_PER_DTC * RBR_ISOBUS_DTC_LIST_SIZE_DU16];
+  static uint16_t dm1Lens[BENCH_INPUTS / 16];
+  static uint16_t benchEcus[FLEET_MAX_ECUS];
+  FleetInit(&benchFleet);
+  for (i = 0; i < BENCH_INPUTS / 16; i++)
   {
-    return startVal;
+    dm1Lens[i] = DmEncode(DmLampsFromCompact(i & MASK_4LSB), dtcLists[i], dtcCounts[i], dm1Payloads[i], sizeof(dm1Payloads[i]));
   }
-  else
+  BenchRun("FleetUpdateFromDm1 (unchanged DM1)", 1000000, [&](uint64_t n) {
+    uint32_t ecu = n & (FLEET_MAX_ECUS - 1);
+    uint32_t list = ecu & (mask >> 4);
+    BenchConsume(FleetUpdateFromDm1(&benchFleet, ecu / 256, ecu & MASK_8LSB, dm1Payloads[list], dm1Lens[list]));
+  });
+  BenchRun("FleetUpdateFromDm1 (new DM1)", 1000000, [&](uint64_t n) {
+    uint32_t ecu = n & (FLEET_MAX_ECUS - 1);
+    uint32_t list = (ecu + n / FLEET_MAX_ECUS + 1) & (mask >> 4);
+    BenchConsume(FleetUpdateFromDm1(&benchFleet, ecu / 256, ecu & MASK_8LSB, dm1Payloads[list], dm1Lens[list]));
+  });
+  BenchRun("FleetCountEcusWithDtc (4096 ECUs)", 1000000, [&](uint64_t n) {
+    BenchConsume(FleetCountEcusWithDtc(&benchFleet, (int)(n % NUM_DTC_CODES)));
+  });
+  BenchRun("FleetEcusWithAll (2 DTCs, 4096 ECUs)", 1000000, [&](uint64_t n) {
+    int codes[2] = { (int)(n % NUM_DTC_CODES), (int)((n / NUM_DTC_CODES + 7 * n) % NUM_DTC_CODES) };
+    BenchConsume(FleetEcusWithAll(&benchFleet, codes, 2, benchEcus, FLEET_MAX_ECUS));
+  });
+  FleetFree(&benchFleet);
+  BenchRun("ExtractValueFromCanTelegram", 1000000, [&](uint64_t n) {
+    uint64_t out = 0;
+    memcpy(INFO_MM7_A_TX2.data, payloads[n & mask], 8);
+    ExtractValueFromCanTelegram(INFO_MM7_A_TX2, spnIndex[n & mask], &out);
+    BenchConsume(out);
+  });
+  bit_field_ts benchFields[2];
+  BitFieldCompile(2, 4, 12, BYTE_ORDER_INTEL, false, BYTES_PER_PAYLOAD, &benchFields[0]);
+  BitFieldCompile(5, 3, 20, BYTE_ORDER_MOTOROLA, true, BYTES_PER_PAYLOAD, &benchFields[1]);
+  BenchRun("BitFieldExtract (precompiled, Intel/Motorola signed)", 1000000, [&](uint64_t n) {
+    BenchConsume(BitFieldExtract(&benchFields[n & 1], LoadPayload64(payloads[n & mask])));
+  });
+  // MM7 TX1/TX2/TX3 packed into one 24-byte CAN FD frame: 24 SPNs per frame
+  static can_isobus_info benchFd;
+  benchFd = INFO_MM7_A_TX1;
+  benchFd.lenMax = 24;
+  for (i = 0; i < MM7_TX2_NUM; i++)
   {
-    if (timerMillis(&startTime, timeout, false, 0, false) || startVal == endVal) // if startVal == endVal, no need to ramp, set finishedRamp to TRUE
+    benchFd.spns[MM7_TX2_NUM + i] = INFO_MM7_A_TX2.spns[i];
+    benchFd.spns[MM7_TX2_NUM + i].byte += BYTES_PER_PAYLOAD;
+    benchFd.spns[2 * MM7_TX2_NUM + i] = INFO_MM7_A_TX3.spns[i];
+    benchFd.spns[2 * MM7_TX2_NUM + i].byte += 2 * BYTES_PER_PAYLOAD;
+  }
+  bit_field_ts benchFdFields[MAX_NUM_SPNS];
+  bit_field_batch_ts benchFdBatch;
+  int benchFdNum = BitFieldCompileMessage(&benchFd, benchFdFields);
+  BitFieldBatchCompile(&benchFd, &benchFdBatch);
+  BenchRun("BitFieldExtractData (FD, 24 SPNs)", 200000, [&](uint64_t n) {
+    uint64_t sum = 0;
+    int s;
+    for (s = 0; s < benchFdNum; s++)
     {
-      *finishedRamp = true;
-      return endVal;
+      sum += BitFieldExtractData(&benchFdFields[s], payloads[n & (mask >> 1)]); // rows are contiguous, 3 of them make a 24-byte frame
+    }
+    BenchConsume(sum);
+  });
+  BenchRun("BitFieldExtractBatch (FD, 24 SPNs)", 200000, [&](uint64_t n) {
+    uint64_t out[BIT_FIELD_BATCH_MAX] = { 0 };
+    BitFieldExtractBatch(&benchFdBatch, payloads[n & (mask >> 1)], out);
+    BenchConsume(out[0] + out[n % 24]);
+  });
+  // gateway: MM7 TX2 roll rate, ax and their status into a customer layout with other scalings
+  static can_isobus_info benchGwSrc;
+  static can_isobus_info benchGwDst;
+  static gateway_plan_ts benchGwPlan;
+  benchGwSrc = INFO_MM7_A_TX2;
+  benchGwSrc.pgn = 0xFF3F;
+  benchGwDst = {};
+  benchGwDst.pgn = 0xFF10;
+  benchGwDst.lenMax = 8;
+  benchGwDst.spns[0] = { .spnNum = 0, .byte = 1, .bit = 1, .len = 16, .scaling = 0.01f, .offset = -320, .varType = TYPE_FLOAT };   // affine: -320..322.55 deg/s
+  benchGwDst.spns[1] = { .spnNum = 0, .byte = 3, .bit = 1, .len = 16, .scaling = 0.0025f, .offset = -80, .varType = TYPE_FLOAT };  // affine: -80..80.6
+  benchGwDst.spns[2] = { .spnNum = 0, .byte = 5, .bit = 1, .len = 4, .scaling = 1, .offset = 0, .varType = TYPE_INT };             // copy
+  benchGwDst.spns[3] = { .spnNum = 0, .byte = 6, .bit = 1, .len = 12, .scaling = 0.007f, .offset = -14, .varType = TYPE_FLOAT };   // float: -14..14.1
+  gateway_map_ts benchGwMaps[] = { { MM7_TX2_ROLL_RATE, 0 }, { MM7_TX2_AX, 1 }, { MM7_TX2_ROLL_RATE_STAT, 2 }, { MM7_TX2_AX, 3 } };
+  GatewayCompile(&benchGwSrc, &benchGwDst, benchGwMaps, 4, &benchGwPlan);
+  GatewayRouteAdd(&benchGwPlan, PGN_ROUTE_ANY_SRC);
+  uint32_t benchGwId = J1939BuildId(6, benchGwSrc.pgn, 0xE2, J1939_GLOBAL_ADDR);
+  // don't time a mapping that is wrong: 1 deg/s and -1.5 must come out as the same physical values
+  {
+    can_isobus_info* updated[1];
+    uint8_t rx[8] = { 0 };
+    float rollRate;
+    float ax;
+    memcpy(benchGwSrc.data, rx, 8);
+    InsertValueToCanTelegram(&benchGwSrc, MM7_TX2_ROLL_RATE, 0x8000 + 200);
+    InsertValueToCanTelegram(&benchGwSrc, MM7_TX2_AX, 0x8000 - 1200);
+    memcpy(rx, benchGwSrc.data, 8);
+    GatewayProcessFrame(benchGwId, rx, 8, updated, 1);
+    uint64_t rawRollRate = 0;
+    uint64_t rawAx = 0;
+    ExtractValueFromCanTelegram(benchGwDst, 0, &rawRollRate);
+    ExtractValueFromCanTelegram(benchGwDst, 1, &rawAx);
+    ScaleAndOffset(rawRollRate, benchGwDst.spns[0], &rollRate);
+    ScaleAndOffset(rawAx, benchGwDst.spns[1], &ax);
+    if (fabsf(rollRate - 1.0f) > 0.005f || fabsf(ax + 1.5f) > 0.00125f)
+    {
+      printf("gateway maps roll rate 1.0 to %f and ax -1.5 to %f, not benchmarking it\n", rollRate, ax);
+      return 1;
+    }
+  }
+  BenchRun("GatewayProcessFrame (4 SPNs)", 1000000, [&](uint64_t n) {
+    can_isobus_info* updated[1];
+    BenchConsume(GatewayProcessFrame(benchGwId, payloads[n & mask], 8, updated, 1) + benchGwDst.data[n & 7]);
+  });
+  BenchRun("Extract+ScaleAndOffset+Insert (4 SPNs)", 1000000, [&](uint64_t n) {
+    memcpy(benchGwSrc.data, payloads[n & mask], 8);
+    int m;
+    for (m = 0; m < 4; m++)
+    {
+      const spn_info* src = &benchGwSrc.spns[benchGwMaps[m].srcSpn];
+      const spn_info* dst = &benchGwDst.spns[benchGwMaps[m].dstSpn];
+      uint64_t raw = 0;
+      spn_value_tu value;
+      ExtractValueFromCanTelegram(benchGwSrc, benchGwMaps[m].srcSpn, &raw);
+      ScaleAndOffset(raw, *src, &value);
+      float phys = (src->varType == TYPE_INT) ? (float)value.i : value.f;
+      float dstRaw = std::clamp((phys - SpnPhysicalOffset(dst)) / dst->scaling + 0.5f, 0.0f, ldexpf(1.0f, dst->len) - 1.0f);
+      InsertValueToCanTelegram(&benchGwDst, benchGwMaps[m].dstSpn, (uint64_t)dstRaw);
     }
-    return scale(millis(), startTime, startTime + timeout, startVal, endVal, true);
+    BenchConsume(benchGwDst.data[n & 7]);
+  });
+  BenchRun("InsertValueToCanTelegram", 1000000, [&](uint64_t n) {
+    InsertValueToCanTelegram(&INFO_MM7_A_TX2, spnIndex[n & mask], rawVals[n & mask]);
+    BenchConsume(INFO_MM7_A_TX2.data[n & 7]);
+  });
+  BenchRun("ScaleAndOffset", 1000000, [&](uint64_t n) {
+    const spn_info* spn = &INFO_MM7_A_TX2.spns[spnIndex[n & mask]];
+    spn_value_tu value;
+    ScaleAndOffset(rawVals[n & mask], *spn, &value);
+    BenchConsume((spn->varType == TYPE_INT) ? (int64_t)value.i : (int64_t)value.f);
+  });
+  BenchRun("scale", 1000000, [&](uint64_t n) {
+    BenchConsume((int64_t)scale(scaleIn[n & mask], 0.0, 100.0, 0.0, 5000.0, true));
+  });
+  // ENG_1 engine hours at 1 s with +-1 ms jitter, one 0.05 h step every 3 minutes
+  ts_series_ts benchSeries;
+  TsSeriesInit(&benchSeries, 247);
+  BenchRun("TsSeriesAppend (engine hours)", 1000000, [&](uint64_t n) {
+    BenchConsume(TsSeriesAppend(&benchSeries, n * 1000 + (rawVals[n & mask] % 3), 1000.0f + 0.05f * (float)(n / 180)));
+  });
+  printf("%-36s %.2f bytes/sample\n", "", (double)TsSeriesBytes(&benchSeries) / benchSeries.numSamples);
+  BenchRun("TsBlockDecode (per block)", 2000, [&](uint64_t n) {
+    static uint64_t times[TS_BLOCK_MAX_DECODED];
+    static float values[TS_BLOCK_MAX_DECODED];
+    BenchConsume(TsBlockDecode(&benchSeries.blocks[n % (benchSeries.numBlocks - 1)], times, values));
+  });
+  printf("%-36s %u samples per block\n", "", benchSeries.blocks[0].header.numSamples);
+  TsSeriesFree(&benchSeries);
+  BenchRun("timerMillis (fake millis)", 1000000, [&](uint64_t n) {
+    static uint64_t prev = 0;
+    BenchConsume(timerMillis(&prev, 100, true, n, true));
+  });
+  BenchRun("timerMillis", 1000000, [&](uint64_t n) {
+    static uint64_t prev = 0;
+    BenchConsume(timerMillis(&prev, 100, true, 0, false));
+  });
+  BenchRun("millis", 1000000, [&](uint64_t n) { BenchConsume(millis()); });
+  BenchRun("micros", 1000000, [&](uint64_t n) { BenchConsume(micros()); });
+  BenchRun("nanos", 1000000, [&](uint64_t n) { BenchConsume(nanos()); });
+  BenchRun("random()", 1000000, [&](uint64_t n) { BenchConsume(random()); });
+  BenchRun("random(max)", 1000000, [&](uint64_t n) { BenchConsume(random((int64_t)(n & mask) + 1)); });
+  BenchRun("random(min, max)", 1000000, [&](uint64_t n) { BenchConsume(random(-(int64_t)(n & mask), (int64_t)(n & 0xFF))); });
+  BenchRun("random(trigger, output)", 1000000, [&](uint64_t n) {
+    bool trigger = true;
+    int64_t out = 0;
+    random(&trigger, &out, true);
+    BenchConsume(out);
+  });
+  BenchRun("invSqrt", 1000000, [&](uint64_t n) { BenchConsume((int64_t)(invSqrt(mathIn2[n & mask]) * 1000.0f)); });
+  BenchRun("fsc_sqrt", 1000000, [&](uint64_t n) { BenchConsume((uint64_t)fsc_sqrt(mathIn2[n & mask])); });
+  BenchRun("sqrtf (reference)", 1000000, [&](uint64_t n) { BenchConsume((uint64_t)sqrtf(mathIn2[n & mask])); });
+  BenchRun("fsc_asinf", 1000000, [&](uint64_t n) { BenchConsume((int64_t)(fsc_asinf(mathIn[n & mask]) * 1000.0f)); });
+  BenchRun("asinf (reference)", 1000000, [&](uint64_t n) { BenchConsume((int64_t)(asinf(mathIn[n & mask]) * 1000.0f)); });
+  BenchRun("fsc_atan2f", 1000000, [&](uint64_t n) { BenchConsume((int64_t)(fsc_atan2f(mathIn[n & mask], mathIn[(n + 1) & mask]) * 1000.0f)); });
+  BenchRun("atan2f (reference)", 1000000, [&](uint64_t n) { BenchConsume((int64_t)(atan2f(mathIn[n & mask], mathIn[(n + 1) & mask]) * 1000.0f)); });
+  // 1, 2, 4... workers up to the number of cores
+  uint32_t numCores = std::thread::hardware_concurrency();
+  uint32_t numWorkers;
+  for (numWorkers = 1; numWorkers <= PIPE_MAX_WORKERS && (numWorkers == 1 || numWorkers <= numCores); numWorkers *= 2)
+  {
+    BenchPipeline((uint8_t)numWorkers, payloads, &rng);
+  }
+
+  if (BenchWriteJson(jsonPath) != 0)
+  {
+    printf("couldn't write %s\n", jsonPath);
+    return 1;
   }
+  printf("results written to %s\n", jsonPath);
+  return 0;
 }
+#endif
 
 
 int main()
 {
+#ifdef BENCHMARK_MODE
+  return RunBenchmarks(BENCHMARK_JSON_PATH);
+#endif
+#ifdef SIMULATION_MODE
+  return RunSimulation();
+#endif
+  ramp_scenario_ts scenario;
+  RampScenarioInit(&scenario, millis());
   for (;;)
   {
-    static uint64_t prevPrintTime = -100;
-    uint64_t printTimeout = 100;
-    uint8_t count = 0;
-
-    static uint64_t prevRampStart = millis() + 1000;
-    const uint64_t RAMP_TIMEOUT = 5000;
-    const uint64_t minVal = 0;
-    const uint64_t maxVal = 5000;
-    static bool finishedRamp = false;
-
-    uint64_t output = 0;
-
-
-    output = timeRampScale(prevRampStart, RAMP_TIMEOUT, minVal, maxVal, &finishedRamp);
-
-    if (timerMillis(&prevPrintTime, printTimeout, true, 0, false))
-    {
-      uint64_t timeElapsed = millis() - prevRampStart;
-      printf("time: %d, output: %d\n", timeElapsed, output);
-    }
-
-    static uint64_t progStart = millis();
-    const uint64_t programTimeout = 6200;
-    if (timerMillis(&progStart, programTimeout, false, 0, false))
+    TRACE_SCOPE(TRACE_MAIN_LOOP);
+    uint64_t nextDeadline; // only the simulation needs it, here we simply poll
+    if (RampScenarioPoll(&scenario, &nextDeadline))
     {
+      TraceDump(stdout);
       while (true)
       {
       }
@@ -861,42 +5652,19 @@ int main()
 
 int getBoolFromCanTelegram(uint8_t telegram[], uint8_t sizeOfTelegram, bool* output, SPN_Config spnConfig)
 {
-  if ((8 * spnConfig.byte + spnConfig.bit + spnConfig.len) > (sizeOfTelegram * 8)) // Check if we are asking for something outside of telegram's allocation
+  bit_field_ts field;
+  if (BitFieldCompile(spnConfig.byte, spnConfig.bit, spnConfig.len, BYTE_ORDER_INTEL, false, sizeOfTelegram, &field) != 0) // Check if we are asking for something outside of telegram's allocation
     return -1;	// Return -1 if we overrun the array?
-
-  int mask = 0;
-  int i = 0;
-  for (i; i < spnConfig.len; i++)
-  {
-    mask |= (1 << i);
-  }
-  int val = (telegram[spnConfig.byte] >> spnConfig.bit) & mask;
-  if (val)
-    *output = true;
-  else
-    *output = false;
+  *output = BitFieldExtract(&field, LoadTelegram64(&telegram[field.byteOffset], sizeOfTelegram - field.byteOffset)) != 0;
   return 0;
 }
 
 int getIntFromCanTelegram(uint8_t telegram[], uint8_t sizeOfTelegram, int* output, SPN_Config spnConfig)
 {
-  if ((8 * spnConfig.byte + spnConfig.bit + spnConfig.len) > (sizeOfTelegram * 8)) // Check if we are asking for something outside of telegram's allocation
+  bit_field_ts field;
+  if (BitFieldCompile(spnConfig.byte, spnConfig.bit, spnConfig.len, BYTE_ORDER_INTEL, false, sizeOfTelegram, &field) != 0) // Check if we are asking for something outside of telegram's allocation
     return -1;	// Return -1 if we overrun the array?
-
-  int mask = 0;
-  int i = 0;
-  for (i; i < spnConfig.len; i++)
-  {
-    mask |= (1 << i);
-  }
-  int val = 0;
-  uint8_t numBytes = 1 + (spnConfig.bit + spnConfig.len) / 8;
-  i = 0;
-  for (i; i < numBytes; i++)
-  {
-    val |= telegram[spnConfig.byte + i] << (8 * i);
-  }
-  *output = (val >> spnConfig.bit) & mask;
+  *output = (int)BitFieldExtract(&field, LoadTelegram64(&telegram[field.byteOffset], sizeOfTelegram - field.byteOffset));
   return 0;
 }
 
@@ -972,7 +5740,6 @@ int64_t random(int64_t min, int64_t max)
 {
   int64_t minVal = (min < max) ? min : max;	//	Find min/max values incase someone gave us parameters in the wrong order
   int64_t maxVal = (min > max) ? min : max;
-  printf("minVal = %lld, maxVal = %lld\n", minVal, maxVal);
   int64_t diff = maxVal - minVal;
   return random(diff) + minVal;
 }
@@ -1042,7 +5809,7 @@ bool timerMillis(uint64_t* prevTime, uint64_t timeout, bool resetPrevTime, uint6
   {
     if (resetPrevTime)
     {
-      *prevTime = millis();
+      *prevTime = current_time; // the time we compared against, not a fresh millis() (which would ignore a fake time)
     }
     return 1;
   }
@@ -1065,53 +5832,55 @@ long long epochMillis()
 //return a 64 bit millis() since the program started. This makes the output very similar to (not) Arduino's hours() function
 uint64_t hours()
 {
-  auto now = std::chrono::steady_clock::now();
-  auto now_ms = std::chrono::duration_cast<std::chrono::hours>(now - startTime).count();
-  uint64_t ms = (uint64_t)now_ms;
-  return ms;
+  return nanos() / 3600000000000ull;
 }
 
 //return a 64 bit millis() since the program started. This makes the output very similar to (not) Arduino's minutes() function
 uint64_t minutes()
 {
-  auto now = std::chrono::steady_clock::now();
-  auto now_ms = std::chrono::duration_cast<std::chrono::minutes>(now - startTime).count();
-  uint64_t ms = (uint64_t)now_ms;
-  return ms;
+  return nanos() / 60000000000ull;
 }
 
 //return a 64 bit millis() since the program started. This makes the output very similar to (not) Arduino's seconds() function
 uint64_t seconds()
 {
-  auto now = std::chrono::steady_clock::now();
-  auto now_ms = std::chrono::duration_cast<std::chrono::seconds>(now - startTime).count();
-  uint64_t ms = (uint64_t)now_ms;
-  return ms;
+  return nanos() / 1000000000ull;
 }
 
 //return a 64 bit millis() since the program started. This makes the output very similar to Arduino's millis() function
 uint64_t millis()
 {
-  auto now = std::chrono::steady_clock::now();
-  auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime).count();
-  uint64_t ms = (uint64_t)now_ms;
-  return ms;
+  return nanos() / 1000000ull;
 }
 
 //return a 64 bit micros() since the program started. This makes the output very similar to Arduino's micros() function
 uint64_t micros()
 {
-  auto now = std::chrono::steady_clock::now();
-  auto now_us = std::chrono::duration_cast<std::chrono::microseconds>(now - startTime).count();
-  uint64_t us = (uint64_t)now_us;
-  return us;
+  return nanos() / 1000ull;
 }
 
 //return a 64 bit nanos() since the program started. This makes the output very similar to (not) Arduino's nanos() function
+//all the functions above go through here, so a virtual time source (see setTimeSource()) moves them all
 uint64_t nanos()
+{
+  if (timeSource != NULL)
+    return timeSource(timeSourceCtx);
+  return wallNanos();
+}
+
+//nanos() from steady_clock, whatever the time source is. For things that measure real time, like tracing
+uint64_t wallNanos()
 {
   auto now = std::chrono::steady_clock::now();
   auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - startTime).count();
   uint64_t ns = (uint64_t)now_ns;
   return  ns;
+}
+
+//replaces the clock behind hours()...nanos(). source returns ns since program start and mustn't go backwards,
+//NULL goes back to steady_clock. Not thread safe, switch it before starting threads that read the time
+void setTimeSource(time_source_fn source, void* ctx)
+{
+  timeSource = source;
+  timeSourceCtx = ctx;
 }
\ No newline at end of file